@@ -0,0 +1,264 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * Throughput of the base64 codecs against the OpenSSL BIO chain they replaced, from small fields to the avatar of the
+ * example and large attachments, and an attachment of the given size encoded in chunks:
+ *
+ *     $ make base64-bench
+ *     $ ./base64-bench [ megabytes ]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+
+#include "base64.h"
+#include "avatar.h"
+
+/* The former implementation, which builds a BIO chain for every call. */
+static char *
+bio_base64(const char *in, int in_len, int *out_len)
+{
+    BIO *buf, *b64;
+    char *ptr, *out;
+    long len;
+
+    buf = BIO_new(BIO_s_mem());
+    BIO_set_close(buf, BIO_CLOSE);
+
+    b64 = BIO_new(BIO_f_base64());
+    BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
+    BIO_push(b64, buf);
+
+    BIO_write(b64, in, in_len);
+    BIO_flush(b64);
+
+    len = BIO_get_mem_data(buf, &ptr);
+    out = malloc((len + 1) * sizeof(char));
+    memcpy(out, ptr, len);
+    out[len] = '\0';
+    *out_len = len + 1;
+
+    BIO_free_all(b64);
+    return out;
+}
+
+static char *
+bio_unbase64(const char *in, int in_len, int *out_len)
+{
+    BIO *buf, *b64;
+    char *out;
+    long len;
+
+    buf = BIO_new_mem_buf(in, in_len);
+    BIO_set_close(buf, BIO_CLOSE);
+
+    b64 = BIO_new(BIO_f_base64());
+    BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
+    BIO_push(b64, buf);
+
+    out = malloc((in_len + 1) * sizeof(char));
+    len = BIO_read(b64, out, in_len);
+    out[len] = '\0';
+    *out_len = len;
+
+    BIO_free_all(b64);
+    return out;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *what, size_t size, size_t bytes, double seconds)
+{
+    printf("%-10zu %-22s %10.1f MB/s %12.0f calls/s\n", size, what, bytes / seconds / (1024 * 1024),
+           bytes / size / seconds);
+}
+
+static void
+bench(const char *data, size_t size, size_t total)
+{
+    size_t i, calls = total / size + 1;
+    size_t encoded_size = base64_encoded_size(size);
+    char *encoded = malloc(encoded_size + 1);
+    char *decoded = malloc(size + 1);
+    double start;
+    int len;
+
+    base64_encode(data, size, encoded);
+    encoded[encoded_size] = '\0';
+
+    start = now();
+    for (i = 0; i < calls; i++) {
+        free(bio_base64(data, (int) size, &len));
+    }
+    report("BIO encode", size, calls * size, now() - start);
+
+    start = now();
+    for (i = 0; i < calls; i++) {
+        free(base64(data, (int) size, &len));
+    }
+    report("base64", size, calls * size, now() - start);
+
+    start = now();
+    for (i = 0; i < calls; i++) {
+        base64_encode(data, size, encoded);
+    }
+    report("base64_encode", size, calls * size, now() - start);
+
+    start = now();
+    for (i = 0; i < calls; i++) {
+        free(bio_unbase64(encoded, (int) encoded_size, &len));
+    }
+    report("BIO decode", size, calls * size, now() - start);
+
+    start = now();
+    for (i = 0; i < calls; i++) {
+        free(unbase64(encoded, (int) encoded_size, &len));
+    }
+    report("unbase64", size, calls * size, now() - start);
+
+    start = now();
+    for (i = 0; i < calls; i++) {
+        if (base64_decode(encoded, encoded_size, decoded) != size) {
+            fprintf(stderr, "failed to decode %zu bytes\n", size);
+            exit(EXIT_FAILURE);
+        }
+    }
+    report("base64_decode", size, calls * size, now() - start);
+
+    if (memcmp(decoded, data, size) != 0) {
+        fprintf(stderr, "decoded %zu bytes do not match\n", size);
+        exit(EXIT_FAILURE);
+    }
+    free(encoded);
+    free(decoded);
+}
+
+/* An attachment encoded and decoded in chunks, as it would be read from a file or a socket, against the whole of it at
+   once. The chunked codecs only hold a chunk of input and of output. */
+static size_t
+encode_chunks(const char *data, size_t size, size_t chunk, char *out, int append)
+{
+    base64_state state;
+    size_t i, n, len = 0;
+
+    base64_encode_init(&state);
+    for (i = 0; i < size; i += n) {
+        n = size - i < chunk ? size - i : chunk;
+        len += base64_encode_update(&state, data + i, n, out + (append ? len : 0));
+    }
+    return len + base64_encode_final(&state, out + (append ? len : 0));
+}
+
+static size_t
+decode_chunks(const char *data, size_t size, size_t chunk, char *out, int append)
+{
+    base64_state state;
+    size_t i, n, len = 0;
+
+    base64_decode_init(&state);
+    for (i = 0; i < size; i += n) {
+        n = size - i < chunk ? size - i : chunk;
+        len += base64_decode_update(&state, data + i, n, out + (append ? len : 0));
+    }
+    return len + base64_decode_final(&state, out + (append ? len : 0));
+}
+
+static void
+bench_stream(const char *data, size_t size, size_t chunk)
+{
+    size_t encoded_size = base64_encoded_size(size);
+    char *encoded = malloc(encoded_size);
+    char *decoded = malloc(size);
+    char *out = malloc(base64_encoded_size(chunk));
+    double start;
+
+    start = now();
+    base64_encode(data, size, encoded);
+    report("base64_encode", size, size, now() - start);
+
+    start = now();
+    encode_chunks(data, size, chunk, out, 0);
+    report("chunked encode", size, size, now() - start);
+
+    start = now();
+    base64_decode(encoded, encoded_size, decoded);
+    report("base64_decode", size, size, now() - start);
+
+    start = now();
+    decode_chunks(encoded, encoded_size, chunk, out, 0);
+    report("chunked decode", size, size, now() - start);
+
+    /* the same again, into whole buffers to check the output */
+    if (encode_chunks(data, size, chunk, encoded, 1) != encoded_size ||
+        decode_chunks(encoded, encoded_size, chunk, decoded, 1) != size || memcmp(decoded, data, size) != 0) {
+        fprintf(stderr, "chunked codecs do not match\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("%-10zu %-22s %10zu bytes of buffers, against %zu at once\n", size, "chunks",
+           chunk + base64_encoded_size(chunk), size + encoded_size);
+    free(encoded);
+    free(decoded);
+    free(out);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const size_t sizes[] = {64, 1024, 65536, 1048576};
+    size_t i, total = 64 * 1024 * 1024;
+    char *data = malloc(sizes[3]);
+
+    if (argc > 1) {
+        total = (size_t) atoi(argv[1]) * 1024 * 1024;
+    }
+    srand(2020);
+    for (i = 0; i < sizes[3]; i++) {
+        data[i] = (char) rand();
+    }
+
+    printf("%-10s %-22s %15s %20s\n", "bytes", "codec", "throughput", "rate");
+    bench(data, sizes[0], total / 8);
+    bench(data, sizes[1], total / 2);
+    bench((const char *) avatar_jpg, avatar_jpg_len, total);
+    bench(data, sizes[2], total);
+    bench(data, sizes[3], total);
+
+    free(data);
+    data = malloc(total);
+    for (i = 0; i < total; i++) {
+        data[i] = (char) rand();
+    }
+    bench_stream(data, total, 65536);
+
+    free(data);
+    return 0;
+}
@@ -1,54 +1,471 @@
+#include <stdlib.h>
 #include <string.h>
 
-#include <openssl/bio.h>
-#include <openssl/evp.h>
+#include "base64.h"
 
-char *
-base64(const char *in, int in_len, int *out_len)
+/* The bulk of the input goes through SSSE3 or AVX2 kernels on x86, the best
+   one the processor supports is selected when the program is loaded. Define
+   BASE64_NO_SIMD to build the portable version only. */
+#if !defined(BASE64_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define BASE64_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+static const char encode_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* The values of the characters, 255 for the ones outside of the alphabet. */
+static const unsigned char decode_table[256] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,  62, 255, 255, 255,  63,
+     52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255, 255, 255, 255,
+    255,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+     15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, 255, 255, 255, 255, 255,
+    255,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+     41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+};
+
+/* The kernels take whole groups of the input, and return how much of it they
+   consumed: a multiple of 3 bytes for encoding, of 4 characters for decoding.
+   A decoding kernel stops before the first block with invalid characters. */
+static size_t
+encode_scalar(const unsigned char *in, size_t len, char *out)
 {
-    BIO *buf, *b64;
-    char *ptr, *out;
-    long len;
+    size_t i;
 
-    buf = BIO_new(BIO_s_mem());
-    BIO_set_close(buf, BIO_CLOSE);
+    for (i = 0; i + 3 <= len; i += 3) {
+        unsigned v = (unsigned) in[i] << 16 | (unsigned) in[i + 1] << 8 | in[i + 2];
+        *out++ = encode_table[v >> 18];
+        *out++ = encode_table[(v >> 12) & 63];
+        *out++ = encode_table[(v >> 6) & 63];
+        *out++ = encode_table[v & 63];
+    }
+    return i;
+}
 
-    b64 = BIO_new(BIO_f_base64());
-    BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-    BIO_push(b64, buf);
+static size_t
+decode_scalar(const char *in, size_t len, unsigned char *out)
+{
+    const unsigned char *s = (const unsigned char *) in;
+    size_t i;
 
-    BIO_write(b64, in, in_len);
-    BIO_flush(b64);
+    for (i = 0; i + 4 <= len; i += 4) {
+        unsigned a = decode_table[s[i]], b = decode_table[s[i + 1]];
+        unsigned c = decode_table[s[i + 2]], d = decode_table[s[i + 3]];
+        unsigned v;
+        if ((a | b | c | d) & 0x80)
+            break;
+        v = a << 18 | b << 12 | c << 6 | d;
+        *out++ = (unsigned char) (v >> 16);
+        *out++ = (unsigned char) (v >> 8);
+        *out++ = (unsigned char) v;
+    }
+    return i;
+}
 
-    len = BIO_get_mem_data(buf, &ptr);
-    out = malloc((len + 1) * sizeof(char));
-    memcpy(out, ptr, len);
-    out[len] = '\0';
-    *out_len = len + 1;
+#ifdef BASE64_SIMD_X86
+/* Spread the 12 bytes in the low part of each 128-bit lane into 16 indices of
+   6 bits, then map them to the alphabet with a table of offsets, see
+   "Faster Base64 Encoding and Decoding using AVX2 Instructions" by Wojciech
+   Muła, Nathan Kurz and Daniel Lemire. */
+__attribute__((target("ssse3"))) static __m128i
+encode_block_ssse3(__m128i in)
+{
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i t0, t1, indices, result;
 
-    BIO_free_all(b64);
-    return out;
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    indices = _mm_or_si128(t0, t1);
+
+    result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    result = _mm_or_si128(result, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, result), indices);
 }
 
-char *
-unbase64(const char *in, int in_len, int *out_len)
+__attribute__((target("ssse3"))) static size_t
+encode_ssse3(const unsigned char *in, size_t len, char *out)
+{
+    size_t i;
+
+    /* every load reads 16 bytes to encode 12 */
+    for (i = 0; i + 16 <= len; i += 12, out += 16) {
+        _mm_storeu_si128((__m128i *) out, encode_block_ssse3(_mm_loadu_si128((const __m128i *) (in + i))));
+    }
+    return i + encode_scalar(in + i, len - i, out);
+}
+
+__attribute__((target("avx2"))) static size_t
+encode_avx2(const unsigned char *in, size_t len, char *out)
+{
+    const __m256i shift_lut = _mm256_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1, 10, 11, 9, 10, 7, 8,
+                                            6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    size_t i;
+
+    /* the lanes take 12 bytes each, read from two loads of 16 */
+    for (i = 0; i + 28 <= len; i += 24, out += 32) {
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (in + i))),
+                                            _mm_loadu_si128((const __m128i *) (in + i + 12)), 1);
+        __m256i t0, t1, indices, result;
+
+        v = _mm256_shuffle_epi8(v, shuffle);
+        t0 = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        t1 = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        indices = _mm256_or_si256(t0, t1);
+
+        result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        result = _mm256_or_si256(
+                result, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+        _mm256_storeu_si256((__m256i *) out, _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, result), indices));
+    }
+    return i + encode_ssse3(in + i, len - i, out);
+}
+
+/* Classify the characters by their nibbles to find the invalid ones, turn the
+   valid ones into their values with a table indexed by the high nibble, and
+   pack the 6-bit values into bytes with multiply-adds, as in the paper of
+   Muła and Lemire. */
+__attribute__((target("ssse3"))) static size_t
+decode_ssse3(const char *in, size_t len, unsigned char *out)
+{
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+                                         0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                         0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    size_t i;
+
+    /* every store writes 16 bytes for 12, the input left keeps them in bounds */
+    for (i = 0; i + 24 <= len; i += 16, out += 12) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (in + i));
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask_2f);
+        __m128i lo = _mm_shuffle_epi8(lut_lo, _mm_and_si128(v, mask_2f));
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        __m128i roll;
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF)
+            break;
+        roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(v, mask_2f), hi_nibbles));
+        v = _mm_add_epi8(v, roll);
+        v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+        v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128((__m128i *) out, v);
+    }
+    return i + decode_scalar(in + i, len - i, out);
+}
+
+__attribute__((target("avx2"))) static size_t
+decode_avx2(const char *in, size_t len, unsigned char *out)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+                                            0x1B, 0x1B, 0x1B, 0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19,
+                                              4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5, 4,
+                                          10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t i;
+
+    for (i = 0; i + 48 <= len; i += 32, out += 24) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (in + i));
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask_2f);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, _mm256_and_si256(v, mask_2f));
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        __m256i roll;
+
+        if (!_mm256_testz_si256(lo, hi))
+            break;
+        roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(v, mask_2f), hi_nibbles));
+        v = _mm256_add_epi8(v, roll);
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, pack);
+        v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256((__m256i *) out, v);
+    }
+    return i + decode_ssse3(in + i, len - i, out);
+}
+
+static size_t (*encode_bulk)(const unsigned char *in, size_t len, char *out) = encode_scalar;
+static size_t (*decode_bulk)(const char *in, size_t len, unsigned char *out) = decode_scalar;
+
+__attribute__((constructor)) static void
+base64_select_kernels(void)
 {
-    BIO *buf, *b64;
-    char *out;
-    long len;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        encode_bulk = encode_avx2;
+        decode_bulk = decode_avx2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        encode_bulk = encode_ssse3;
+        decode_bulk = decode_ssse3;
+    }
+}
+#else
+#define encode_bulk encode_scalar
+#define decode_bulk decode_scalar
+#endif
 
-    buf = BIO_new_mem_buf(in, in_len);
-    BIO_set_close(buf, BIO_CLOSE);
+size_t
+base64_encoded_size(size_t len)
+{
+    return (len + 2) / 3 * 4;
+}
 
-    b64 = BIO_new(BIO_f_base64());
-    BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-    BIO_push(b64, buf);
+size_t
+base64_decoded_size(const char *in, size_t len)
+{
+    if (len > 0 && in[len - 1] == '=')
+        len--;
+    if (len > 0 && in[len - 1] == '=')
+        len--;
+    return len / 4 * 3 + (len % 4 ? len % 4 - 1 : 0);
+}
 
-    out = malloc((in_len + 1) * sizeof(char));
-    len = BIO_read(b64, out, in_len);
+/* Encode the last 1 or 2 bytes with the padding. */
+static size_t
+encode_tail(const unsigned char *s, size_t len, char *out)
+{
+    if (len == 1) {
+        out[0] = encode_table[s[0] >> 2];
+        out[1] = encode_table[(s[0] & 3) << 4];
+        out[2] = '=';
+        out[3] = '=';
+        return 4;
+    } else if (len == 2) {
+        out[0] = encode_table[s[0] >> 2];
+        out[1] = encode_table[(s[0] & 3) << 4 | s[1] >> 4];
+        out[2] = encode_table[(s[1] & 15) << 2];
+        out[3] = '=';
+        return 4;
+    }
+    return 0;
+}
+
+/* Decode a group of 4 characters, which may end with padding. Returns the
+   number of bytes, or BASE64_INVALID. */
+static size_t
+decode_group(const unsigned char *s, unsigned char *out, int *padded)
+{
+    unsigned a = decode_table[s[0]], b = decode_table[s[1]], c, d;
+
+    if ((a | b) & 0x80)
+        return BASE64_INVALID;
+    out[0] = (unsigned char) (a << 2 | b >> 4);
+    if (s[3] == '=') {
+        *padded = 1;
+        if (s[2] == '=')
+            return 1;
+        c = decode_table[s[2]];
+        if (c & 0x80)
+            return BASE64_INVALID;
+        out[1] = (unsigned char) (b << 4 | c >> 2);
+        return 2;
+    }
+    c = decode_table[s[2]], d = decode_table[s[3]];
+    if ((c | d) & 0x80)
+        return BASE64_INVALID;
+    out[1] = (unsigned char) (b << 4 | c >> 2);
+    out[2] = (unsigned char) (c << 6 | d);
+    return 3;
+}
+
+size_t
+base64_encode(const void *in, size_t len, char *out)
+{
+    const unsigned char *s = (const unsigned char *) in;
+    size_t done = encode_bulk(s, len, out);
+
+    return done / 3 * 4 + encode_tail(s + done, len - done, out + done / 3 * 4);
+}
+
+size_t
+base64_decode(const char *in, size_t len, void *out)
+{
+    const unsigned char *s = (const unsigned char *) in;
+    unsigned char *ptr = (unsigned char *) out;
+    unsigned a, b, c;
+    size_t done;
+
+    if (len > 0 && in[len - 1] == '=') {
+        if (len % 4)
+            return BASE64_INVALID;
+        len -= in[len - 2] == '=' ? 2 : 1;
+    }
+    done = decode_bulk(in, len, ptr);
+    ptr += done / 4 * 3;
+    switch (len - done) {
+        case 0:
+            break;
+        case 2:
+            a = decode_table[s[done]], b = decode_table[s[done + 1]];
+            if ((a | b) & 0x80)
+                return BASE64_INVALID;
+            *ptr++ = (unsigned char) (a << 2 | b >> 4);
+            break;
+        case 3:
+            a = decode_table[s[done]], b = decode_table[s[done + 1]], c = decode_table[s[done + 2]];
+            if ((a | b | c) & 0x80)
+                return BASE64_INVALID;
+            *ptr++ = (unsigned char) (a << 2 | b >> 4);
+            *ptr++ = (unsigned char) (b << 4 | c >> 2);
+            break;
+        default:
+            /* a single character, or a group the kernel stopped at */
+            return BASE64_INVALID;
+    }
+    return ptr - (unsigned char *) out;
+}
+
+void
+base64_encode_init(base64_state *state)
+{
+    state->ncarry = 0;
+    state->padded = 0;
+}
+
+size_t
+base64_encode_update(base64_state *state, const void *in, size_t len, char *out)
+{
+    const unsigned char *s = (const unsigned char *) in;
+    char *ptr = out;
+    size_t done;
+
+    if (state->ncarry) {
+        while (state->ncarry < 3 && len > 0) {
+            state->carry[state->ncarry++] = *s++;
+            len--;
+        }
+        if (state->ncarry < 3)
+            return 0;
+        ptr += encode_scalar(state->carry, 3, ptr) / 3 * 4;
+        state->ncarry = 0;
+    }
+    done = encode_bulk(s, len, ptr);
+    ptr += done / 3 * 4;
+    memcpy(state->carry, s + done, len - done);
+    state->ncarry = (int) (len - done);
+    return ptr - out;
+}
+
+size_t
+base64_encode_final(base64_state *state, char *out)
+{
+    size_t len = encode_tail(state->carry, state->ncarry, out);
+    state->ncarry = 0;
+    return len;
+}
+
+void
+base64_decode_init(base64_state *state)
+{
+    state->ncarry = 0;
+    state->padded = 0;
+}
+
+size_t
+base64_decode_update(base64_state *state, const char *in, size_t len, void *out)
+{
+    const unsigned char *s = (const unsigned char *) in;
+    unsigned char *ptr = (unsigned char *) out;
+    size_t done, n;
+
+    if (state->ncarry) {
+        while (state->ncarry < 4 && len > 0) {
+            state->carry[state->ncarry++] = *s++;
+            len--;
+        }
+        if (state->ncarry < 4)
+            return 0;
+        if (state->padded || (n = decode_group(state->carry, ptr, &state->padded)) == BASE64_INVALID)
+            return BASE64_INVALID;
+        ptr += n;
+        state->ncarry = 0;
+    }
+    if (len > 0 && state->padded)
+        return BASE64_INVALID;
+    done = decode_bulk((const char *) s, len, ptr);
+    ptr += done / 4 * 3;
+    /* the kernels stop before the padding, or before invalid characters */
+    for (; len - done >= 4; done += 4) {
+        if (state->padded || (n = decode_group(s + done, ptr, &state->padded)) == BASE64_INVALID)
+            return BASE64_INVALID;
+        ptr += n;
+    }
+    if (len > done && state->padded)
+        return BASE64_INVALID;
+    memcpy(state->carry, s + done, len - done);
+    state->ncarry = (int) (len - done);
+    return ptr - (unsigned char *) out;
+}
+
+size_t
+base64_decode_final(base64_state *state, void *out)
+{
+    unsigned char group[4];
+    int padded = 0;
+
+    if (state->ncarry == 0)
+        return 0;
+    if (state->ncarry == 1 || memchr(state->carry, '=', state->ncarry))
+        return BASE64_INVALID;
+    /* an unpadded last group decodes as if it was padded */
+    memcpy(group, state->carry, state->ncarry);
+    memset(group + state->ncarry, '=', 4 - state->ncarry);
+    state->ncarry = 0;
+    return decode_group(group, (unsigned char *) out, &padded);
+}
+
+char *
+base64(const char *in, int in_len, int *out_len)
+{
+    size_t len = base64_encoded_size(in_len);
+    char *out = malloc(len + 1);
+
+    if (!out)
+        return NULL;
+    base64_encode(in, in_len, out);
     out[len] = '\0';
-    *out_len = len;
+    *out_len = (int) len + 1;
+    return out;
+}
 
-    BIO_free_all(b64);
+char *
+unbase64(const char *in, int in_len, int *out_len)
+{
+    size_t len = base64_decoded_size(in, in_len);
+    char *out = malloc(len + 1);
+
+    *out_len = 0;
+    if (!out)
+        return NULL;
+    len = base64_decode(in, in_len, out);
+    if (len == BASE64_INVALID) {
+        free(out);
+        return NULL;
+    }
+    out[len] = '\0';
+    *out_len = (int) len;
     return out;
 }
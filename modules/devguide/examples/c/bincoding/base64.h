@@ -1,9 +1,73 @@
 #ifndef BASE64_H
 #define BASE64_H
 
+#include <stddef.h>
+
+/* Returned by base64_decode for malformed input. */
+#define BASE64_INVALID ((size_t) -1)
+
+/* The exact number of characters base64_encode writes for len bytes. */
+size_t
+base64_encoded_size(size_t len);
+
+/* The exact number of bytes base64_decode writes for the len characters at in,
+   when they are well-formed. */
+size_t
+base64_decoded_size(const char *in, size_t len);
+
+/* Encode len bytes into out, which has room for base64_encoded_size(len)
+   characters. The output is padded and not NUL-terminated. Returns the number
+   of characters written. */
+size_t
+base64_encode(const void *in, size_t len, char *out);
+
+/* Decode len characters into out, which has room for base64_decoded_size(in,
+   len) bytes. The padding is optional. Returns the number of bytes written, or
+   BASE64_INVALID if the input is not base64. */
+size_t
+base64_decode(const char *in, size_t len, void *out);
+
+/* The state of an incremental encoding or decoding, which carries the bytes or
+   characters of an incomplete group from one chunk to the next. */
+typedef struct {
+    unsigned char carry[4];
+    int ncarry;
+    int padded;
+} base64_state;
+
+void
+base64_encode_init(base64_state *state);
+
+/* Encode the next len bytes into out, which has room for
+   base64_encoded_size(len) characters. Returns the number of characters
+   written, the last bytes of the chunk may be held back for the next one. */
+size_t
+base64_encode_update(base64_state *state, const void *in, size_t len, char *out);
+
+/* Write the held back bytes and the padding, at most 4 characters. */
+size_t
+base64_encode_final(base64_state *state, char *out);
+
+void
+base64_decode_init(base64_state *state);
+
+/* Decode the next len characters into out, which has room for
+   (len + 3) / 4 * 3 bytes. Returns the number of bytes written, or
+   BASE64_INVALID if the input is not base64, including any characters
+   after the padding. */
+size_t
+base64_decode_update(base64_state *state, const char *in, size_t len, void *out);
+
+/* Write the bytes of an unpadded last group, at most 2. Returns
+   BASE64_INVALID if the input stopped in the middle of a character. */
+size_t
+base64_decode_final(base64_state *state, void *out);
+
+/* Encode into a new NUL-terminated string, *out_len includes the NUL. */
 char *
 base64(const char *in, int in_len, int *out_len);
 
+/* Decode into a new NUL-terminated buffer, or NULL if the input is not base64. */
 char *
 unbase64(const char *in, int in_len, int *out_len);
 
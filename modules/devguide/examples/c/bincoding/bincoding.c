@@ -20,13 +20,15 @@
  *
  * This is a minimal example file showing how to encode custom binary formats to be embedded into document.
  *
- * It stores user avatar along with profile information.
+ * It stores user avatar along with profile information, either as JSON with the avatar encoded in base64, or in a
+ * compact binary layout with the raw bytes of the avatar. The flags of the document tell the readers which one it is.
  */
 
 #include <stdio.h>
 #include <libcouchbase/couchbase.h>
 #include <libcouchbase/api3.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h> /* strlen */
 
 #ifdef _WIN32
@@ -37,9 +39,8 @@
 
 #endif
 
-#include "base64.h"
 #include "avatar.h"
-#include "cJSON.h"
+#include "profile.h"
 
 static void
 die(lcb_INSTANCE instance, const char *msg, lcb_error_t err)
@@ -48,80 +49,6 @@ die(lcb_INSTANCE instance, const char *msg, lcb_error_t err)
     exit(EXIT_FAILURE);
 }
 
-typedef struct {
-    char *name;
-    int age;
-    void *avatar;
-    int avatar_len;
-} Profile;
-
-static Profile *
-new_profile()
-{
-    return calloc(1, sizeof(Profile));
-}
-
-static void
-free_profile(Profile *profile)
-{
-    if (profile) {
-        free(profile->name);
-        free(profile->avatar);
-    }
-    free(profile);
-}
-
-static Profile *
-decode_profile(const char *data)
-{
-    Profile *profile = NULL;
-    cJSON *json = cJSON_Parse(data);
-
-    if (json) {
-        cJSON *val;
-
-        profile = new_profile();
-        val = cJSON_GetObjectItem(json, "name");
-        if (val && val->type == cJSON_String) {
-            profile->name = strdup(val->valuestring);
-        }
-        val = cJSON_GetObjectItem(json, "age");
-        if (val && val->type == cJSON_Number) {
-            profile->age = val->valueint;
-        }
-        val = cJSON_GetObjectItem(json, "avatar");
-        if (val && val->type == cJSON_String) {
-            profile->avatar = unbase64(val->valuestring, strlen(val->valuestring),
-                    &profile->avatar_len);
-        }
-        cJSON_Delete(json);
-    }
-    return profile;
-}
-
-static char *
-encode_profile(Profile *profile)
-{
-    cJSON *json = cJSON_CreateObject();
-    if (profile->name) {
-        cJSON *val = cJSON_CreateString(profile->name);
-        cJSON_AddItemToObject(json, "name", val);
-    }
-    if (profile->age) {
-        cJSON *val = cJSON_CreateNumber(profile->age);
-        cJSON_AddItemToObject(json, "age", val);
-    }
-    if (profile->avatar_len > 0 && profile->avatar) {
-        cJSON *val;
-        char *b64_val;
-        int b64_len = 0;
-        b64_val = base64(profile->avatar, profile->avatar_len, &b64_len);
-        val = cJSON_CreateString(b64_val);
-        cJSON_AddItemToObject(json, "avatar", val);
-    }
-    return cJSON_PrintUnformatted(json);
-}
-
 static void
 store_callback(lcb_INSTANCE instance, int cbtype, const lcb_RESPBASE *rb)
 {
@@ -143,18 +70,30 @@ get_callback(lcb_INSTANCE instance, int cbtype, const lcb_RESPBASE *rb)
         FILE *html = fopen(filename, "w+");
         if (html) {
             const lcb_RESPGET *rg = (const lcb_RESPGET *) rb;
-            Profile *profile = decode_profile(rg->value);
-            char *b64_val;
-            int b64_len = 0;
-            b64_val = base64(profile->avatar, profile->avatar_len, &b64_len);
-            fprintf(html, "<img src=\"data:image/jpeg;base64,%.*s\"><br>", b64_len, b64_val);
-            fprintf(html, "<b>NAME:</b> %s<br>", profile->name);
-            fprintf(html, "<b>AGE:</b> %d<br>", profile->age);
+            ProfileView profile;
+            const char *name;
+            /* the view decodes nothing up front, and the base64 avatar of JSON goes to the HTML as it is */
+            if (!profile_view_init(&profile, rg->value, rg->nvalue, rg->itmflags)) {
+                fprintf(stderr, "The profile is malformed or has unknown format (flags: 0x%08X)\n",
+                        (unsigned) rg->itmflags);
+                exit(EXIT_FAILURE);
+            }
+            fprintf(html, "<img src=\"data:image/jpeg;base64,");
+            if (!profile_view_write_avatar_base64(&profile, html)) {
+                fprintf(html, "\">");
+                fclose(html);
+                fprintf(stderr, "The avatar of the profile is not base64\n");
+                exit(EXIT_FAILURE);
+            }
+            fprintf(html, "\"><br>");
+            name = profile_view_name(&profile);
+            fprintf(html, "<b>NAME:</b> %s<br>", name ? name : "");
+            fprintf(html, "<b>AGE:</b> %d<br>", profile_view_age(&profile));
             fclose(html);
             fprintf(stderr,
                     "The profile has been retrieved from Couchbase and stored as HTML in \"%s\"\n",
                     filename);
-            free_profile(profile);
+            profile_view_free(&profile);
         } else {
             perror("failed to open output file for writing");
         }
@@ -172,12 +111,13 @@ main(int argc, char *argv[])
     lcb_CMDSTORE scmd = {0};
     lcb_CMDGET gcmd = {0};
     char *html_filename = "profile.html";
+    int binary = 0;
 
     create_options.version = 3;
 
     if (argc < 2) {
         fprintf(stderr,
-                "Usage: %s couchbase://host/bucket [ password [ username [ filename ] ] ]\n",
+                "Usage: %s couchbase://host/bucket [ password [ username [ filename [ json | binary ] ] ] ]\n",
                 argv[0]);
         exit(EXIT_FAILURE);
     }
@@ -192,6 +132,9 @@ main(int argc, char *argv[])
     if (argc > 4) {
         html_filename = argv[4];
     }
+    if (argc > 5) {
+        binary = strcmp(argv[5], "binary") == 0;
+    }
 
     err = lcb_create(&instance, &create_options);
     if (err != LCB_SUCCESS) {
@@ -219,15 +162,27 @@ main(int argc, char *argv[])
             /* the avatar could have been received via network, or loaded from file system */
             avatar_jpg, avatar_jpg_len};
 
-    /* encoding user data to be stored in Couchbase as JSON */
-    char *json = encode_profile(&profile);
+    /* encoding user data to be stored in Couchbase as JSON, or in the binary layout */
+    char *value;
+    size_t value_len;
+    if (binary) {
+        value = encode_profile_binary(&profile, &value_len);
+        scmd.flags = PROFILE_FORMAT_BINARY;
+        scmd.datatype = LCB_VALUE_RAW;
+    } else {
+        value = encode_profile(&profile);
+        value_len = strlen(value);
+        scmd.flags = PROFILE_FORMAT_JSON;
+        scmd.datatype = LCB_VALUE_F_JSON;
+    }
+    fprintf(stderr, "The profile takes %u bytes as %s\n", (unsigned) value_len, binary ? "binary" : "JSON");
 
     LCB_CMD_SET_KEY(&scmd, id, strlen(id));
-    LCB_CMD_SET_VALUE(&scmd, json, strlen(json));
+    LCB_CMD_SET_VALUE(&scmd, value, value_len);
     scmd.operation = LCB_SET;
 
     err = lcb_store3(instance, NULL, &scmd);
-    free(json); /* now we can release memory occupied by JSON representation of the profile */
+    free(value); /* now we can release memory occupied by the encoded profile */
     if (err != LCB_SUCCESS) {
         die(instance, "Couldn't schedule storage operation", err);
     }
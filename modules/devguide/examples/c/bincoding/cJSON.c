@@ -31,8 +31,27 @@
 #include <limits.h>
 #include <ctype.h>
 #include <assert.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <io.h>
+#define cJSON_read _read
+#define cJSON_write _write
+#else
+#include <unistd.h>
+#define cJSON_read read
+#define cJSON_write write
+#endif
 #include "cJSON.h"
 
+/* The scanners below have SSE2 and AVX2 versions on x86, the best one the
+   processor supports is selected when the library is loaded. Define
+   CJSON_NO_SIMD to build the portable versions only. */
+#if !defined(CJSON_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define CJSON_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
 static int
 cJSON_strcasecmp(const char *s1, const char *s2)
 {
@@ -78,6 +97,14 @@ cJSON_InitHooks(cJSON_Hooks *hooks)
     cJSON_free = (hooks->free_fn) ? hooks->free_fn : free;
 }
 
+/* The strings of the item are not allocated with cJSON_malloc, and must not
+   be released with cJSON_free. */
+#define CJSON_VALUESTRING_BORROWED 1
+#define CJSON_STRING_BORROWED 2
+
+/* valueint64 of the number holds its exact value. */
+#define CJSON_NUMBER_INT64 4
+
 /* The size of pool allocation groups.  Note that the allocation
     pools are only used during parsing, and not generation.
     Additionally, this default value is based on empirical
@@ -87,74 +114,254 @@ cJSON_InitHooks(cJSON_Hooks *hooks)
 #define CJSON_POOL_ALLOC_SIZE 1024
 #endif
 
+/* The size of the chunks, which hold the strings parsed into a pool. Strings
+    longer than a quarter of a chunk get a chunk of their own. */
+#ifndef CJSON_POOL_STRING_SIZE
+#define CJSON_POOL_STRING_SIZE 16384
+#endif
+
+/* The number of items in the blocks of new pools, see cJSON_SetPoolAllocSize. */
+static int cJSON_pool_alloc_size = CJSON_POOL_ALLOC_SIZE;
+
+void
+cJSON_SetPoolAllocSize(int items)
+{
+    cJSON_pool_alloc_size = items > 0 ? items : CJSON_POOL_ALLOC_SIZE;
+}
+
 /* Creates a new allocation pool. */
 static cJSON_PoolBlock *
 cJSON_New_PoolBlock(cJSON_Pool *pool)
 {
-    int i;
+    size_t i, count = pool->alloc_size;
     cJSON *item, *new_alloc;
     cJSON_PoolBlock *new_block;
 
-    if (CJSON_POOL_ALLOC_SIZE <= 0) {
+    if (count == 0) {
         return 0;
     }
 
-    new_block = (cJSON_PoolBlock *) cJSON_malloc(
-            sizeof(cJSON_PoolBlock) + sizeof(cJSON) * CJSON_POOL_ALLOC_SIZE);
+    new_block = (cJSON_PoolBlock *) cJSON_malloc(sizeof(cJSON_PoolBlock) + sizeof(cJSON) * count);
     if (!new_block) {
         return 0;
     }
 
     new_alloc = (cJSON *) (new_block + 1);
 
-    memset(new_block, 0, sizeof(cJSON_PoolBlock) + sizeof(cJSON) * CJSON_POOL_ALLOC_SIZE);
+    memset(new_block, 0, sizeof(cJSON_PoolBlock) + sizeof(cJSON) * count);
+    new_block->size = count;
 
     new_block->next = pool->blocks;
     pool->blocks = new_block;
+    pool->bytes += sizeof(cJSON_PoolBlock) + sizeof(cJSON) * count;
 
-    for (i = 0, item = new_alloc; i < CJSON_POOL_ALLOC_SIZE; ++i, ++item) {
+    for (i = 0, item = new_alloc; i < count; ++i, ++item) {
         item->next = pool->free_items;
         pool->free_items = item;
     }
 
+    /* the first block is sized for the input, the others are full */
+    if (cJSON_pool_alloc_size > 0)
+        pool->alloc_size = (unsigned int) cJSON_pool_alloc_size;
+
     return new_block;
 }
 
-/* This will create an allocation pool */
+/* Per thread cache of the pools of deleted trees, see
+   cJSON_SetPoolCacheLimit. */
+#if defined(_MSC_VER)
+#define CJSON_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define CJSON_THREAD_LOCAL __thread
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define CJSON_THREAD_LOCAL _Thread_local
+#endif
+
+#ifdef CJSON_THREAD_LOCAL
+typedef struct {
+    cJSON_Pool *pools; /* linked through next_cached */
+    size_t retained;   /* the bytes of the pools */
+    size_t limit;
+} cJSON_PoolCache;
+
+static CJSON_THREAD_LOCAL cJSON_PoolCache pool_cache;
+#endif
+
+/* This will create an allocation pool. size is the length of the input,
+   which bounds the number of items. */
 static cJSON_Pool *
-cJSON_New_Pool(void)
+cJSON_New_Pool(size_t size)
 {
-    if (CJSON_POOL_ALLOC_SIZE <= 0) {
-        return 0;
-    } else {
-        cJSON_Pool *pool = (cJSON_Pool *) cJSON_malloc(sizeof(cJSON_Pool));
-        if (!pool) {
-            return 0;
-        }
-
-        memset(pool, 0, sizeof(cJSON_Pool));
-        pool->free_items = 0;
-        pool->blocks = 0;
-        pool->refcount = 0;
+    cJSON_Pool *pool;
+    size_t count;
 
+    if (cJSON_pool_alloc_size <= 0) {
+        return 0;
+    }
+#ifdef CJSON_THREAD_LOCAL
+    if (pool_cache.pools) {
+        pool = pool_cache.pools;
+        pool_cache.pools = pool->next_cached;
+        pool_cache.retained -= pool->bytes;
+        pool->next_cached = 0;
         return pool;
     }
+#endif
+
+    pool = (cJSON_Pool *) cJSON_malloc(sizeof(cJSON_Pool));
+    if (!pool) {
+        return 0;
+    }
+
+    memset(pool, 0, sizeof(cJSON_Pool));
+    pool->free_items = 0;
+    pool->blocks = 0;
+    pool->refcount = 0;
+    pool->strings = 0;
+    pool->strings_next = 0;
+    pool->strings_avail = 0;
+
+    /* Every item but the root takes at least two bytes of text, like "1,",
+       so the first block needs no more items than that. */
+    count = size / 2 + 1;
+    if (count < 16)
+        count = 16;
+    if (count > (size_t) cJSON_pool_alloc_size)
+        count = (size_t) cJSON_pool_alloc_size;
+    pool->alloc_size = (unsigned int) count;
+
+    /* Neither are the decoded strings longer than the input. */
+    pool->string_size = size < CJSON_POOL_STRING_SIZE ? size + 1 : CJSON_POOL_STRING_SIZE;
+
+    return pool;
 }
 
-/* This will destroy an allocation pool */
 static void
-cJSON_Destroy_Pool(cJSON_Pool *pool)
+cJSON_Free_Blocks(cJSON_PoolBlock *cur)
 {
-    cJSON_PoolBlock *cur = pool->blocks, *next;
+    cJSON_PoolBlock *next;
     while (cur) {
         next = cur->next;
         /* this frees all the allocations as well */
         cJSON_free(cur);
         cur = next;
     }
+}
+
+/* This will destroy an allocation pool */
+static void
+cJSON_Destroy_Pool(cJSON_Pool *pool)
+{
+    cJSON_Free_Blocks(pool->blocks);
+    cJSON_Free_Blocks(pool->strings);
     cJSON_free(pool);
 }
 
+/* Forget the strings of a pool which has no items left, keeping only the
+   head chunk for the strings of the next tree. */
+static void
+cJSON_Trim_Pool(cJSON_Pool *pool)
+{
+    cJSON_PoolBlock *chunk = pool->strings;
+
+    if (chunk && chunk->next) {
+        cJSON_Free_Blocks(chunk->next);
+        chunk->next = 0;
+        pool->bytes = 0;
+        for (chunk = pool->blocks; chunk; chunk = chunk->next)
+            pool->bytes += sizeof(cJSON_PoolBlock) + sizeof(cJSON) * chunk->size;
+        chunk = pool->strings;
+        pool->bytes += sizeof(cJSON_PoolBlock) + chunk->size;
+    }
+    if (chunk) {
+        pool->strings_next = (char *) (chunk + 1);
+        pool->strings_avail = chunk->size;
+    }
+}
+
+#ifdef CJSON_THREAD_LOCAL
+/* Keep the pool, whose last item is node, in the cache of this thread if
+   there is room for it. The items are already zeroed and on the free list,
+   but for node. Of the strings only the head chunk is kept. */
+static int
+cJSON_Cache_Pool(cJSON_Pool *pool, cJSON *node)
+{
+    if (!pool_cache.limit) {
+        return 0;
+    }
+    cJSON_Trim_Pool(pool);
+    if (pool_cache.retained + pool->bytes > pool_cache.limit) {
+        return 0;
+    }
+
+    memset(node, 0, sizeof(cJSON));
+    node->next = pool->free_items;
+    pool->free_items = node;
+
+    pool->next_cached = pool_cache.pools;
+    pool_cache.pools = pool;
+    pool_cache.retained += pool->bytes;
+    return 1;
+}
+#endif
+
+void
+cJSON_SetPoolCacheLimit(size_t max_bytes)
+{
+#ifdef CJSON_THREAD_LOCAL
+    pool_cache.limit = max_bytes;
+    while (pool_cache.pools && pool_cache.retained > max_bytes) {
+        cJSON_Pool *pool = pool_cache.pools;
+        pool_cache.pools = pool->next_cached;
+        pool_cache.retained -= pool->bytes;
+        cJSON_Destroy_Pool(pool);
+    }
+#else
+    (void) max_bytes;
+#endif
+}
+
+void
+cJSON_FreePoolCache(void)
+{
+    cJSON_SetPoolCacheLimit(0);
+}
+
+/* allocate string from a pool, it lives until the pool is destroyed */
+static char *
+cJSON_Pool_New_String(cJSON_Pool *pool, size_t len)
+{
+    char *str;
+
+    if (len > pool->strings_avail) {
+        size_t size = len > CJSON_POOL_STRING_SIZE / 4 ? len : pool->string_size;
+        cJSON_PoolBlock *block;
+        if (size < len)
+            size = len;
+        block = (cJSON_PoolBlock *) cJSON_malloc(sizeof(cJSON_PoolBlock) + size);
+        if (!block) {
+            return 0;
+        }
+        block->size = size;
+        pool->bytes += sizeof(cJSON_PoolBlock) + size;
+        if (size == len && pool->strings) {
+            /* keep bumping in the current chunk */
+            block->next = pool->strings->next;
+            pool->strings->next = block;
+            return (char *) (block + 1);
+        }
+        block->next = pool->strings;
+        pool->strings = block;
+        pool->strings_next = (char *) (block + 1);
+        pool->strings_avail = size;
+        pool->string_size = CJSON_POOL_STRING_SIZE;
+    }
+    str = pool->strings_next;
+    pool->strings_next += len;
+    pool->strings_avail -= len;
+    return str;
+}
+
 /* allocate new item from a pool */
 static cJSON *
 cJSON_Pool_New_Item(cJSON_Pool *pool)
@@ -181,6 +388,10 @@ cJSON_Pool_Free_Item(cJSON_Pool *pool, cJSON *node)
         to the pool if we are destroying the pool anyways. */
     assert(pool->refcount);
     if (--pool->refcount == 0) {
+#ifdef CJSON_THREAD_LOCAL
+        if (cJSON_Cache_Pool(pool, node))
+            return;
+#endif
         cJSON_Destroy_Pool(pool);
     } else {
         memset(node, 0, sizeof(cJSON));
@@ -217,254 +428,1227 @@ cJSON_Free_Item(cJSON *node)
     }
 }
 
-/* Delete a cJSON structure. */
+static void
+cJSON_Drop_Index(cJSON *item);
+
+/* Release the strings and the memory of a single item. */
+static void
+cJSON_Delete_Item(cJSON *c)
+{
+    cJSON_Drop_Index(c);
+    if (!(c->type & cJSON_IsReference) && c->valuestring && !(c->flags & CJSON_VALUESTRING_BORROWED))
+        cJSON_free(c->valuestring);
+    if (c->string && !(c->flags & CJSON_STRING_BORROWED))
+        cJSON_free(c->string);
+    cJSON_Free_Item(c);
+}
+
+/* Delete a cJSON structure. Children without children of their own are
+   deleted on the spot, the others are moved in front of their parent to be
+   deleted first. That way any depth is deleted without recursion. */
 void
 cJSON_Delete(cJSON *c)
 {
-    cJSON *next;
+    cJSON *next, *child;
     while (c) {
+        if (!(c->type & cJSON_IsReference)) {
+            cJSON_Drop_Index(c);
+            while ((child = c->child) && ((child->type & cJSON_IsReference) || !child->child)) {
+                c->child = child->next;
+                cJSON_Delete_Item(child);
+            }
+            if (child) {
+                c->child = child->next;
+                child->next = c;
+                c = child;
+                continue;
+            }
+        }
         next = c->next;
-        if (!(c->type & cJSON_IsReference) && c->child)
-            cJSON_Delete(c->child);
-        if (!(c->type & cJSON_IsReference) && c->valuestring)
-            cJSON_free(c->valuestring);
-        if (c->string)
-            cJSON_free(c->string);
-        cJSON_Free_Item(c);
+        cJSON_Delete_Item(c);
         c = next;
     }
 }
 
-/* Parse the input text to generate a number, and populate the result into item. */
+/* The input of the parser. Nothing is read at or past end, and when insitu
+   is set the input is mutable, and the strings are decoded in place. */
+typedef struct {
+    const char *end;
+    int insitu;
+} parse_buffer;
+
+/* The character at p, or 0 past the end of the input. */
+static char
+peek(const parse_buffer *pb, const char *p)
+{
+    return p < pb->end ? *p : 0;
+}
+
+/* The fields of IEEE 754 double. */
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+
+/* The powers of ten which are exactly representable as doubles. */
+static const double exact_pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/* 10^-64 .. 10^64 as 128-bit {high, low} significands rounded down, with
+   the top bit set. */
+#define POW10_128_MIN -64
+#define POW10_128_MAX 64
+static const uint64_t pow10_128[][2] = {
+        {0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL},
+        {0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL},
+        {0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL},
+        {0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL},
+        {0xcdb02555653131b6ULL, 0x3792f412cb06794dULL},
+        {0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL},
+        {0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL},
+        {0xc8de047564d20a8bULL, 0xf245825a5a445275ULL},
+        {0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL},
+        {0x9ced737bb6c4183dULL, 0x55464dd69685606bULL},
+        {0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL},
+        {0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL},
+        {0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL},
+        {0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL},
+        {0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL},
+        {0x95a8637627989aadULL, 0xdde7001379a44aa8ULL},
+        {0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL},
+        {0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL},
+        {0x9226712162ab070dULL, 0xcab3961304ca70e8ULL},
+        {0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL},
+        {0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL},
+        {0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL},
+        {0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL},
+        {0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL},
+        {0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL},
+        {0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL},
+        {0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL},
+        {0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL},
+        {0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL},
+        {0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL},
+        {0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL},
+        {0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL},
+        {0xcfb11ead453994baULL, 0x67de18eda5814af2ULL},
+        {0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL},
+        {0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL},
+        {0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL},
+        {0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL},
+        {0x9e74d1b791e07e48ULL, 0x775ea264cf55347dULL},
+        {0xc612062576589ddaULL, 0x95364afe032a819dULL},
+        {0xf79687aed3eec551ULL, 0x3a83ddbd83f52204ULL},
+        {0x9abe14cd44753b52ULL, 0xc4926a9672793542ULL},
+        {0xc16d9a0095928a27ULL, 0x75b7053c0f178293ULL},
+        {0xf1c90080baf72cb1ULL, 0x5324c68b12dd6338ULL},
+        {0x971da05074da7beeULL, 0xd3f6fc16ebca5e03ULL},
+        {0xbce5086492111aeaULL, 0x88f4bb1ca6bcf584ULL},
+        {0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e5ULL},
+        {0x9392ee8e921d5d07ULL, 0x3aff322e62439fcfULL},
+        {0xb877aa3236a4b449ULL, 0x09befeb9fad487c2ULL},
+        {0xe69594bec44de15bULL, 0x4c2ebe687989a9b3ULL},
+        {0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a10ULL},
+        {0xb424dc35095cd80fULL, 0x538484c19ef38c94ULL},
+        {0xe12e13424bb40e13ULL, 0x2865a5f206b06fb9ULL},
+        {0x8cbccc096f5088cbULL, 0xf93f87b7442e45d3ULL},
+        {0xafebff0bcb24aafeULL, 0xf78f69a51539d748ULL},
+        {0xdbe6fecebdedd5beULL, 0xb573440e5a884d1bULL},
+        {0x89705f4136b4a597ULL, 0x31680a88f8953030ULL},
+        {0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3dULL},
+        {0xd6bf94d5e57a42bcULL, 0x3d32907604691b4cULL},
+        {0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b10fULL},
+        {0xa7c5ac471b478423ULL, 0x0fcf80dc33721d53ULL},
+        {0xd1b71758e219652bULL, 0xd3c36113404ea4a8ULL},
+        {0x83126e978d4fdf3bULL, 0x645a1cac083126e9ULL},
+        {0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a3ULL},
+        {0xccccccccccccccccULL, 0xccccccccccccccccULL},
+        {0x8000000000000000ULL, 0x0000000000000000ULL},
+        {0xa000000000000000ULL, 0x0000000000000000ULL},
+        {0xc800000000000000ULL, 0x0000000000000000ULL},
+        {0xfa00000000000000ULL, 0x0000000000000000ULL},
+        {0x9c40000000000000ULL, 0x0000000000000000ULL},
+        {0xc350000000000000ULL, 0x0000000000000000ULL},
+        {0xf424000000000000ULL, 0x0000000000000000ULL},
+        {0x9896800000000000ULL, 0x0000000000000000ULL},
+        {0xbebc200000000000ULL, 0x0000000000000000ULL},
+        {0xee6b280000000000ULL, 0x0000000000000000ULL},
+        {0x9502f90000000000ULL, 0x0000000000000000ULL},
+        {0xba43b74000000000ULL, 0x0000000000000000ULL},
+        {0xe8d4a51000000000ULL, 0x0000000000000000ULL},
+        {0x9184e72a00000000ULL, 0x0000000000000000ULL},
+        {0xb5e620f480000000ULL, 0x0000000000000000ULL},
+        {0xe35fa931a0000000ULL, 0x0000000000000000ULL},
+        {0x8e1bc9bf04000000ULL, 0x0000000000000000ULL},
+        {0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL},
+        {0xde0b6b3a76400000ULL, 0x0000000000000000ULL},
+        {0x8ac7230489e80000ULL, 0x0000000000000000ULL},
+        {0xad78ebc5ac620000ULL, 0x0000000000000000ULL},
+        {0xd8d726b7177a8000ULL, 0x0000000000000000ULL},
+        {0x878678326eac9000ULL, 0x0000000000000000ULL},
+        {0xa968163f0a57b400ULL, 0x0000000000000000ULL},
+        {0xd3c21bcecceda100ULL, 0x0000000000000000ULL},
+        {0x84595161401484a0ULL, 0x0000000000000000ULL},
+        {0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL},
+        {0xcecb8f27f4200f3aULL, 0x0000000000000000ULL},
+        {0x813f3978f8940984ULL, 0x4000000000000000ULL},
+        {0xa18f07d736b90be5ULL, 0x5000000000000000ULL},
+        {0xc9f2c9cd04674edeULL, 0xa400000000000000ULL},
+        {0xfc6f7c4045812296ULL, 0x4d00000000000000ULL},
+        {0x9dc5ada82b70b59dULL, 0xf020000000000000ULL},
+        {0xc5371912364ce305ULL, 0x6c28000000000000ULL},
+        {0xf684df56c3e01bc6ULL, 0xc732000000000000ULL},
+        {0x9a130b963a6c115cULL, 0x3c7f400000000000ULL},
+        {0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL},
+        {0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL},
+        {0x96769950b50d88f4ULL, 0x1314448000000000ULL},
+        {0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL},
+        {0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL},
+        {0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL},
+        {0xb7abc627050305adULL, 0xf14a3d9e40000000ULL},
+        {0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL},
+        {0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL},
+        {0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL},
+        {0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL},
+        {0x8c213d9da502de45ULL, 0x4526f422cc340000ULL},
+        {0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL},
+        {0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL},
+        {0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL},
+        {0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL},
+        {0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL},
+        {0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL},
+        {0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL},
+        {0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL},
+        {0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL},
+        {0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL},
+        {0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL},
+        {0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL},
+        {0x9f4f2726179a2245ULL, 0x01d762422c946590ULL},
+        {0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL},
+        {0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL},
+        {0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL},
+        {0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL}
+};
+
+/* The 128-bit product of a and b. */
+static void
+multiply_u64(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 r = (unsigned __int128) a * b;
+    *hi = (uint64_t) (r >> 64);
+    *lo = (uint64_t) r;
+#else
+    const uint64_t m32 = 0xFFFFFFFFULL;
+    uint64_t a1 = a >> 32, a0 = a & m32, b1 = b >> 32, b0 = b & m32;
+    uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    uint64_t mid = (p00 >> 32) + (p01 & m32) + (p10 & m32);
+    *hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+    *lo = (mid << 32) | (p00 & m32);
+#endif
+}
+
+/* Convert mantissa * 10^scale to the nearest double with the algorithm of
+   Daniel Lemire, "Number Parsing at a Gigabyte per Second", after Michael
+   Eisel. Returns 0 for the rare inputs it cannot round with certainty. */
+static int
+eisel_lemire(uint64_t mantissa, int scale, double *out)
+{
+    const uint64_t *pow10;
+    uint64_t hi, lo, yhi, ylo, result, exp2;
+    int clz = 0;
+
+    if (scale < POW10_128_MIN || scale > POW10_128_MAX)
+        return 0;
+    pow10 = pow10_128[scale - POW10_128_MIN];
+    while (!(mantissa & 0x8000000000000000ULL)) {
+        mantissa <<= 1;
+        clz++;
+    }
+    /* floor(scale * log2(10)) + 64 + 1023 - clz */
+    exp2 = (uint64_t) (((217706 * scale) >> 16) + 64 + 1023 - clz);
+
+    multiply_u64(mantissa, pow10[0], &hi, &lo);
+    if ((hi & 0x1FF) == 0x1FF && lo + mantissa < mantissa) {
+        /* the truncated power might have changed the result, look at the
+           lower half of it */
+        multiply_u64(mantissa, pow10[1], &yhi, &ylo);
+        if (lo + yhi < lo)
+            hi++;
+        lo += yhi;
+        if ((hi & 0x1FF) == 0x1FF && lo + 1 == 0 && ylo + mantissa < mantissa)
+            return 0;
+    }
+
+    result = hi >> ((hi >> 63) + 9); /* 54 bits */
+    exp2 -= 1 ^ (hi >> 63);
+    if (lo == 0 && (hi & 0x1FF) == 0 && (result & 3) == 1)
+        return 0; /* halfway between two doubles */
+    result = (result + (result & 1)) >> 1;
+    if (result >> 53) {
+        result >>= 1;
+        exp2++;
+    }
+    if (exp2 - 1 >= 0x7FF - 1)
+        return 0; /* subnormal or out of range */
+    result = (exp2 << 52) | (result & DP_SIGNIFICAND_MASK);
+    memcpy(out, &result, sizeof(*out));
+    return 1;
+}
+
+/* Lex the number at num into *out, and return the position after it. When
+   the number is an integer which fits into 64 bits, *exact is set and
+   *integer receives its value. */
 static const char *
-parse_number(cJSON *item, const char *num)
+lex_number(const char *num, const parse_buffer *pb, double *out, int64_t *integer, int *exact)
 {
-    double n = 0, sign = 1, scale = 0;
-    int subscale = 0, signsubscale = 1;
+    const char *start = num, *end = pb->end;
+    uint64_t mantissa = 0; /* the first 19 significant digits */
+    int digits = 0, truncated = 0, fraction = 0, negative = 0;
+    int scale = 0, subscale = 0, signsubscale = 1;
 
-    /* Could use sscanf for this? */
-    if (*num == '-')
-        sign = -1, num++; /* Has sign? */
-    if (*num == '0')
+    if (peek(pb, num) == '-')
+        negative = 1, num++; /* Has sign? */
+    if (peek(pb, num) == '0')
         num++; /* is zero */
-    if (*num >= '1' && *num <= '9')
-        do
-            n = (n * 10.0) + (*num++ - '0');
-        while (*num >= '0' && *num <= '9'); /* Number? */
-    if (*num == '.') {
-        num++;
-        do
-            n = (n * 10.0) + (*num++ - '0'), scale--;
-        while (*num >= '0' && *num <= '9');
-    }                               /* Fractional part? */
-    if (*num == 'e' || *num == 'E') /* Exponent? */
-    {
+    else
+        for (; num < end && (unsigned) (*num - '0') < 10; num++) {
+            if (digits < 19)
+                mantissa = mantissa * 10 + (*num - '0'), digits++;
+            else
+                scale++, truncated = 1;
+        }
+    if (peek(pb, num) == '.') { /* Fractional part? */
+        fraction = 1;
+        for (num++; num < end && (unsigned) (*num - '0') < 10; num++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*num - '0'), scale--;
+                if (mantissa)
+                    digits++; /* leading zeros are not significant */
+            } else if (*num != '0') {
+                truncated = 1;
+            }
+        }
+    }
+    if (peek(pb, num) == 'e' || peek(pb, num) == 'E') { /* Exponent? */
+        fraction = 1;
         num++;
-        if (*num == '+')
+        if (peek(pb, num) == '+')
             num++;
-        else if (*num == '-')
+        else if (peek(pb, num) == '-')
             signsubscale = -1, num++; /* With sign? */
-        while (*num >= '0' && *num <= '9')
-            subscale = (subscale * 10) + (*num++ - '0'); /* Number? */
+        for (; peek(pb, num) >= '0' && peek(pb, num) <= '9'; num++)
+            if (subscale < 100000)
+                subscale = (subscale * 10) + (*num - '0');
     }
+    scale += subscale * signsubscale;
 
-    n = sign * n * pow(10.0,
-            (scale + subscale * signsubscale)); /* number = +/- number.fraction * 10^+/- exponent */
+    /* -0 is left to the double, the integer would lose its sign */
+    *exact = !fraction && !truncated && mantissa <= (uint64_t) INT64_MAX + negative && !(negative && !mantissa);
+    if (*exact)
+        *integer = negative ? (int64_t) (0 - mantissa) : (int64_t) mantissa;
 
-    item->valuedouble = n;
-    item->valueint = (int) n;
-    item->type = cJSON_Number;
+    if (mantissa == 0) {
+        *out = 0;
+    } else if (!truncated && scale == 0) {
+        *out = (double) mantissa; /* the conversion rounds correctly */
+    } else if (!truncated && mantissa <= ((uint64_t) 1 << 53) && scale >= -22 && scale <= 22) {
+        /* Both the mantissa and the power of ten are exact, so is the
+           result of a single multiplication or division. */
+        *out = scale < 0 ? (double) mantissa / exact_pow10[-scale] : (double) mantissa * exact_pow10[scale];
+    } else if (!truncated && eisel_lemire(mantissa, scale, out)) {
+        /* done */
+    } else {
+        /* Leave the hard cases to the correctly rounded strtod. */
+        char local[64], *copy = local;
+        size_t len = num - start;
+        if (len >= sizeof(local) && !(copy = (char *) cJSON_malloc(len + 1))) {
+            *out = 0;
+            return num;
+        }
+        memcpy(copy, start, len);
+        copy[len] = 0;
+        *out = fabs(strtod(copy, 0));
+        if (copy != local)
+            cJSON_free(copy);
+    }
+    if (negative)
+        *out = -*out;
     return num;
 }
 
-/* Render the number nicely from the given item into a string. */
-static char *
-print_number(cJSON *item)
+/* Convert the double to int saturating at the limits, the plain cast is
+   undefined out of range. */
+static int
+double_to_int(double d)
 {
-    char *str;
-    double d = item->valuedouble;
-    if (fabs(((double) item->valueint) - d) <= DBL_EPSILON && d <= INT_MAX && d >= INT_MIN) {
-        str = (char *) cJSON_malloc(21); /* 2^64+1 can be represented in 21 chars. */
-        sprintf(str, "%d", item->valueint);
-    } else {
-        str = (char *) cJSON_malloc(64); /* This is a nice tradeoff. */
-        if (fabs(floor(d) - d) <= DBL_EPSILON)
-            sprintf(str, "%.0f", d);
-        else if (fabs(d) < 1.0e-6 || fabs(d) > 1.0e9)
-            sprintf(str, "%e", d);
-        else
-            sprintf(str, "%f", d);
-    }
-    return str;
+    if (d >= INT_MAX)
+        return INT_MAX;
+    if (d <= INT_MIN)
+        return INT_MIN;
+    return d == d ? (int) d : 0;
 }
 
-/* Parse the input text into an unescaped cstring, and populate item. */
-static const unsigned char firstByteMark[7] = {0x00, 0x00, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC};
+static int64_t
+double_to_int64(double d)
+{
+    if (d >= 9223372036854775807.0)
+        return INT64_MAX;
+    if (d <= -9223372036854775808.0)
+        return INT64_MIN;
+    return d == d ? (int64_t) d : 0;
+}
+
+/* Store the number into the item. */
+static void
+set_number(cJSON *item, double d)
+{
+    item->valuedouble = d;
+    item->valueint = double_to_int(d);
+    item->valueint64 = double_to_int64(d);
+    item->flags &= ~CJSON_NUMBER_INT64;
+}
+
+static void
+set_int64(cJSON *item, int64_t i)
+{
+    item->valuedouble = (double) i;
+    item->valueint = i > INT_MAX ? INT_MAX : i < INT_MIN ? INT_MIN : (int) i;
+    item->valueint64 = i;
+    item->flags |= CJSON_NUMBER_INT64;
+}
 
+/* Parse the input text to generate a number, and populate the result into item. */
 static const char *
-parse_string(cJSON *item, const char *str)
+parse_number(cJSON *item, const char *num, const parse_buffer *pb)
 {
-    const char *ptr = str + 1;
-    char *ptr2;
-    char *out;
-    int len = 0;
-    unsigned uc;
-    if (*str != '\"')
-        return 0; /* not a string! */
+    double n;
+    int64_t i;
+    int exact;
 
-    while (*ptr != '\"' && (unsigned char) *ptr > 31 && ++len)
-        if (*ptr++ == '\\')
-            ptr++; /* Skip escaped quotes. */
+    num = lex_number(num, pb, &n, &i, &exact);
+    if (exact)
+        set_int64(item, i);
+    else
+        set_number(item, n);
+    item->type = cJSON_Number;
+    return num;
+}
 
-    out = (char *) cJSON_malloc(len + 1); /* This is how long we need for the string, roughly. */
-    if (!out)
-        return 0;
+/* Growable output buffer used by the printer.  The whole tree is rendered
+   into one buffer in a single walk; when noalloc is set the buffer belongs
+   to the caller and cannot be grown. */
+typedef struct {
+    char *buffer;
+    size_t length;
+    size_t offset;
+    int noalloc;
+} printbuffer;
 
-    ptr = str + 1;
-    ptr2 = out;
-    while (*ptr != '\"' && (unsigned char) *ptr > 31) {
-        if (*ptr != '\\')
-            *ptr2++ = *ptr++;
-        else {
-            ptr++;
-            switch (*ptr) {
-            case 'b':*ptr2++ = '\b';
-                break;
-            case 'f':*ptr2++ = '\f';
-                break;
-            case 'n':*ptr2++ = '\n';
-                break;
-            case 'r':*ptr2++ = '\r';
-                break;
-            case 't':*ptr2++ = '\t';
-                break;
-            case 'u': /* transcode utf16 to utf8. DOES NOT SUPPORT SURROGATE PAIRS CORRECTLY. */
-                sscanf(ptr + 1, "%4x", &uc); /* get the unicode char. */
-                len = 3;
-                if (uc < 0x80)
-                    len = 1;
-                else if (uc < 0x800)
-                    len = 2;
-                ptr2 += len;
+/* Make sure there is room for at least "needed" more bytes at the current
+   offset, and return a pointer to it. */
+static char *
+ensure(printbuffer *p, size_t needed)
+{
+    char *newbuffer;
+    size_t newsize;
 
-                switch (len) {
-                case 3:*--ptr2 = ((uc | 0x80) & 0xBF);
-                    uc >>= 6; /* fall through */
-                case 2:*--ptr2 = ((uc | 0x80) & 0xBF);
-                    uc >>= 6; /* fall through */
-                case 1:*--ptr2 = (uc | firstByteMark[len]); /* fall through */
-                }
-                ptr2 += len;
-                ptr += 4;
-                break;
-            default:*ptr2++ = *ptr;
-                break;
-            }
-            ptr++;
-        }
+    needed += p->offset;
+    if (needed <= p->length)
+        return p->buffer + p->offset;
+    if (p->noalloc)
+        return 0;
+
+    newsize = p->length ? p->length : 64;
+    while (newsize < needed)
+        newsize *= 2;
+    newbuffer = (char *) cJSON_malloc(newsize);
+    if (!newbuffer) {
+        cJSON_free(p->buffer);
+        p->buffer = 0;
+        p->length = 0;
+        return 0;
     }
-    *ptr2 = 0;
-    if (*ptr == '\"')
-        ptr++;
-    item->valuestring = out;
-    item->type = cJSON_String;
-    return ptr;
+    if (p->buffer) {
+        memcpy(newbuffer, p->buffer, p->offset);
+        cJSON_free(p->buffer);
+    }
+    p->buffer = newbuffer;
+    p->length = newsize;
+    return newbuffer + p->offset;
 }
 
-/* Render the cstring provided to an escaped version that can be printed. */
+/* Append a known string to the buffer. */
+static int
+print_raw(printbuffer *p, const char *str, size_t len)
+{
+    char *out = ensure(p, len);
+    if (!out)
+        return 0;
+    memcpy(out, str, len);
+    p->offset += len;
+    return 1;
+}
+
+static const char digit_pairs[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                                  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                                  "8081828384858687888990919293949596979899";
+
+/* Write the decimal digits of n to buf, and return the end. */
 static char *
-print_string_ptr(const char *str)
+format_uint64(char *buf, uint64_t n)
 {
-    const char *ptr;
-    char *ptr2, *out;
-    int len = 0;
+    char tmp[20], *ptr = tmp + sizeof(tmp);
+    size_t len;
 
-    if (!str)
-        return cJSON_strdup("");
-    ptr = str;
-    while (*ptr && ++len) {
-        if ((unsigned char) *ptr < 32 || *ptr == '\"' || *ptr == '\\')
-            len++;
-        ptr++;
+    while (n >= 100) {
+        unsigned pair = (unsigned) (n % 100) * 2;
+        n /= 100;
+        *--ptr = digit_pairs[pair + 1];
+        *--ptr = digit_pairs[pair];
     }
-
-    out = (char *) cJSON_malloc(len + 3);
-    ptr2 = out;
-    ptr = str;
-    *ptr2++ = '\"';
-    while (*ptr) {
-        if ((unsigned char) *ptr > 31 && *ptr != '\"' && *ptr != '\\')
-            *ptr2++ = *ptr++;
-        else {
-            *ptr2++ = '\\';
-            switch (*ptr++) {
-            case '\\':*ptr2++ = '\\';
-                break;
-            case '\"':*ptr2++ = '\"';
-                break;
-            case '\b':*ptr2++ = 'b';
-                break;
-            case '\f':*ptr2++ = 'f';
-                break;
-            case '\n':*ptr2++ = 'n';
-                break;
-            case '\r':*ptr2++ = 'r';
-                break;
-            case '\t':*ptr2++ = 't';
-                break;
-            default:ptr2--;
-                break; /* eviscerate with prejudice. */
-            }
-        }
+    if (n >= 10) {
+        *--ptr = digit_pairs[n * 2 + 1];
+        *--ptr = digit_pairs[n * 2];
+    } else {
+        *--ptr = (char) ('0' + n);
     }
-    *ptr2++ = '\"';
-    *ptr2++ = 0;
-    return out;
+    len = tmp + sizeof(tmp) - ptr;
+    memcpy(buf, ptr, len);
+    return buf + len;
 }
 
-/* Invote print_string_ptr (which is useful) on an item. */
 static char *
-print_string(cJSON *item)
+format_int64(char *buf, int64_t n)
 {
-    return print_string_ptr(item->valuestring);
+    if (n < 0) {
+        *buf++ = '-';
+        return format_uint64(buf, 0 - (uint64_t) n);
+    }
+    return format_uint64(buf, (uint64_t) n);
 }
 
-/* Predeclare these prototypes. */
-static const char *
-parse_value(cJSON *item, const char *value);
+/* Shortest round-trip formatting of doubles with the Grisu2 algorithm of
+   Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+   with Integers". The digits always read back as the same double, and are
+   the shortest such digits for all but a tiny fraction of the inputs. */
+typedef struct {
+    uint64_t f;
+    int e;
+} diy_fp;
 
-static char *
-print_value(cJSON *item, int depth, int fmt);
+static diy_fp
+diy_fp_multiply(diy_fp x, diy_fp y)
+{
+    const uint64_t m32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32) + (1ULL << 31); /* round */
+    diy_fp r;
 
-static const char *
-parse_array(cJSON *item, const char *value);
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+    return r;
+}
 
-static char *
-print_array(cJSON *item, int depth, int fmt);
+static diy_fp
+diy_fp_normalize(diy_fp x)
+{
+    while (!(x.f & 0x8000000000000000ULL)) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
 
-static const char *
-parse_object(cJSON *item, const char *value);
+/* The cached powers 10^-348, 10^-340, ..., 10^340 as normalized diy_fp. */
+static const uint64_t cached_powers_f[] = {
+        0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+        0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+        0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+        0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+        0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+        0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+        0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+        0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+        0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+        0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+        0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+        0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+        0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+        0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+        0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+        0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+        0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+        0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+        0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+        0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+        0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+        0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+        0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+        0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+        0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+        0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+        0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+        0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+        0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
 
-static char *
-print_object(cJSON *item, int depth, int fmt);
+static const short cached_powers_e[] = {
+        -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+        -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+        -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+        -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+        56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+        375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+        694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+        1013, 1039, 1066
+};
 
-/* Utility to jump whitespace and cr/lf */
-static const char *
-skip(const char *in)
+/* Find a cached power c = 10^-k such that the exponent of w * c falls
+   into [-60, -32]. */
+static diy_fp
+cached_power(int e, int *k)
 {
-    while (in && *in && (unsigned char) *in <= 32)
-        in++;
-    return in;
+    double dk = (-61 - e) * 0.30102999566398114 + 347; /* dk must be positive, so can do ceiling in positive */
+    int kk = (int) dk;
+    unsigned index;
+    diy_fp c;
+
+    if (dk - kk > 0.0)
+        kk++;
+    index = (unsigned) ((kk >> 3) + 1);
+    *k = -(-348 + (int) (index << 3)); /* decimal exponent no need lookup table */
+    c.f = cached_powers_f[index];
+    c.e = cached_powers_e[index];
+    return c;
 }
 
-/* Parse an object - create a new root, and populate. */
-cJSON *
-cJSON_Parse(const char *value)
+static void
+grisu_round(char *buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
 {
-    cJSON_Pool *pool = cJSON_New_Pool();
-    cJSON *c = 0;
-    if (pool) {
-        c = cJSON_Pool_New_Item(pool);
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static const uint64_t pow10_u64[] = {1ULL,
+                                     10ULL,
+                                     100ULL,
+                                     1000ULL,
+                                     10000ULL,
+                                     100000ULL,
+                                     1000000ULL,
+                                     10000000ULL,
+                                     100000000ULL,
+                                     1000000000ULL,
+                                     10000000000ULL,
+                                     100000000000ULL,
+                                     1000000000000ULL,
+                                     10000000000000ULL,
+                                     100000000000000ULL,
+                                     1000000000000000ULL,
+                                     10000000000000000ULL,
+                                     100000000000000000ULL,
+                                     1000000000000000000ULL,
+                                     10000000000000000000ULL};
+
+/* Generate the digits of w, given the upper boundary mp and the width delta
+   of the rounding interval. */
+static void
+grisu_digits(diy_fp w, diy_fp mp, uint64_t delta, char *buffer, int *len, int *k)
+{
+    const int shift = -mp.e;
+    const uint64_t one = 1ULL << shift;
+    const uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t) (mp.f >> shift);
+    uint64_t p2 = mp.f & (one - 1);
+    int kappa = 1;
+
+    while (kappa < 10 && p1 >= pow10_u64[kappa])
+        kappa++;
+    *len = 0;
+    while (kappa > 0) {
+        uint32_t div = (uint32_t) pow10_u64[kappa - 1];
+        uint32_t d = p1 / div;
+        uint64_t tmp;
+
+        p1 %= div;
+        if (d || *len)
+            buffer[(*len)++] = (char) ('0' + d);
+        kappa--;
+        tmp = ((uint64_t) p1 << shift) + p2;
+        if (tmp <= delta) {
+            *k += kappa;
+            grisu_round(buffer, *len, delta, tmp, pow10_u64[kappa] << shift, wp_w);
+            return;
+        }
+    }
+    for (;;) { /* kappa <= 0 */
+        char d;
+
+        p2 *= 10;
+        delta *= 10;
+        d = (char) (p2 >> shift);
+        if (d || *len)
+            buffer[(*len)++] = (char) ('0' + d);
+        p2 &= one - 1;
+        kappa--;
+        if (p2 < delta) {
+            *k += kappa;
+            grisu_round(buffer, *len, delta, p2, one, -kappa < 20 ? wp_w * pow10_u64[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+/* Write the shortest digits of the positive finite v to buffer, the value
+   is buffer * 10^k. */
+static void
+grisu2(double v, char *buffer, int *len, int *k)
+{
+    uint64_t bits;
+    diy_fp w, mp, mm, c;
+    int biased;
+
+    memcpy(&bits, &v, sizeof(bits));
+    biased = (int) ((bits >> 52) & 0x7FF);
+    w.f = bits & DP_SIGNIFICAND_MASK;
+    if (biased) {
+        w.f += DP_HIDDEN_BIT;
+        w.e = biased - 1075;
+    } else {
+        w.e = -1074;
+    }
+
+    /* the boundaries m+ and m- of the values rounding to v, with m+
+       normalized and m- brought to the same exponent */
+    mp.f = (w.f << 1) + 1;
+    mp.e = w.e - 1;
+    while (!(mp.f & (DP_HIDDEN_BIT << 1))) {
+        mp.f <<= 1;
+        mp.e--;
+    }
+    mp.f <<= 64 - 52 - 2;
+    mp.e -= 64 - 52 - 2;
+    if (w.f == DP_HIDDEN_BIT) {
+        mm.f = (w.f << 2) - 1;
+        mm.e = w.e - 2;
+    } else {
+        mm.f = (w.f << 1) - 1;
+        mm.e = w.e - 1;
+    }
+    mm.f <<= mm.e - mp.e;
+    mm.e = mp.e;
+
+    c = cached_power(mp.e, k);
+    w = diy_fp_multiply(diy_fp_normalize(w), c);
+    mp = diy_fp_multiply(mp, c);
+    mm = diy_fp_multiply(mm, c);
+    mm.f++;
+    mp.f--;
+    grisu_digits(w, mp, mp.f - mm.f, buffer, len, k);
+}
+
+/* Lay out the digits buffer * 10^k the way JavaScript does: plain up to
+   21 integer digits or 6 leading fraction zeros, exponent otherwise. The
+   buffer must have room for 26 bytes. Returns the end. */
+static char *
+format_decimal(char *buffer, int len, int k)
+{
+    const int kk = len + k; /* 10^(kk-1) <= v < 10^kk */
+    int i, exp;
+
+    if (k >= 0 && kk <= 21) { /* 1234e7 -> 12340000000 */
+        for (i = len; i < kk; i++)
+            buffer[i] = '0';
+        return buffer + kk;
+    }
+    if (kk > 0 && kk <= 21) { /* 1234e-2 -> 12.34 */
+        memmove(buffer + kk + 1, buffer + kk, len - kk);
+        buffer[kk] = '.';
+        return buffer + len + 1;
+    }
+    if (kk > -6 && kk <= 0) { /* 1234e-6 -> 0.001234 */
+        const int offset = 2 - kk;
+        memmove(buffer + offset, buffer, len);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        for (i = 2; i < offset; i++)
+            buffer[i] = '0';
+        return buffer + len + offset;
+    }
+    if (len == 1) { /* 1e30 */
+        buffer += 1;
+    } else { /* 1234e30 -> 1.234e33 */
+        memmove(buffer + 2, buffer + 1, len - 1);
+        buffer[1] = '.';
+        buffer += len + 1;
+    }
+    *buffer++ = 'e';
+    exp = kk - 1;
+    if (exp < 0) {
+        *buffer++ = '-';
+        exp = -exp;
+    } else {
+        *buffer++ = '+';
+    }
+    return format_uint64(buffer, (uint64_t) exp);
+}
+
+/* Render the number nicely from the given item into the buffer. */
+static int
+print_number(cJSON *item, printbuffer *p)
+{
+    char str[64], *end = str;
+    double d = item->valuedouble;
+
+    if ((item->flags & CJSON_NUMBER_INT64) && (double) item->valueint64 == d) {
+        end = format_int64(str, item->valueint64);
+    } else if (d != d || d - d != d - d) {
+        return print_raw(p, "null", 4); /* JSON has no NaN or infinity */
+    } else if (d == 0 && signbit(d)) {
+        *end++ = '-';
+        *end++ = '0';
+    } else if (floor(d) == d && fabs(d) < 9.2e18) {
+        end = format_int64(str, (int64_t) d);
+    } else {
+        int len, k;
+        if (d < 0) {
+            *end++ = '-';
+            d = -d;
+        }
+        grisu2(d, end, &len, &k);
+        end = format_decimal(end, len, k);
+    }
+    return print_raw(p, str, (size_t) (end - str));
+}
+
+/* Parse the input text into an unescaped cstring, and populate item. */
+static const unsigned char firstByteMark[7] = {0x00, 0x00, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC};
+
+/* Read four hex digits of \uXXXX escape. Returns 0 on malformed input. */
+static const char *
+parse_hex4(const char *str, const parse_buffer *pb, unsigned *uc)
+{
+    int i;
+    *uc = 0;
+    if (pb->end - str < 4)
+        return 0;
+    for (i = 0; i < 4; i++, str++) {
+        *uc <<= 4;
+        if (*str >= '0' && *str <= '9')
+            *uc += *str - '0';
+        else if (*str >= 'A' && *str <= 'F')
+            *uc += 10 + *str - 'A';
+        else if (*str >= 'a' && *str <= 'f')
+            *uc += 10 + *str - 'a';
+        else
+            return 0;
+    }
+    return str;
+}
+
+/* Returns the first byte in [ptr, end) which cannot be copied verbatim
+   between the quotes of a string: a quote, a backslash or a control
+   character. Returns end if there is none. */
+static const char *
+scan_special_scalar(const char *ptr, const char *end)
+{
+    while (ptr < end && *ptr != '\"' && *ptr != '\\' && (unsigned char) *ptr > 31)
+        ptr++;
+    return ptr;
+}
+
+/* Returns the first byte in [ptr, end) which is not whitespace, where the
+   terminating zero is not whitespace either. Returns end if there is none. */
+static const char *
+skip_space_scalar(const char *ptr, const char *end)
+{
+    while (ptr < end && *ptr && (unsigned char) *ptr <= 32)
+        ptr++;
+    return ptr;
+}
+
+#ifdef CJSON_SIMD_X86
+static const char *
+scan_special_sse2(const char *ptr, const char *end)
+{
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(31);
+
+    while (end - ptr >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) ptr);
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                       _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+        int mask = _mm_movemask_epi8(special);
+        if (mask)
+            return ptr + __builtin_ctz(mask);
+        ptr += 16;
+    }
+    return scan_special_scalar(ptr, end);
+}
+
+static const char *
+skip_space_sse2(const char *ptr, const char *end)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i space = _mm_set1_epi8(31);
+
+    while (end - ptr >= 16) {
+        /* the bytes 1..32 are whitespace, which are 0..31 once decremented */
+        __m128i v = _mm_sub_epi8(_mm_loadu_si128((const __m128i *) ptr), one);
+        int mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, space), v)) & 0xFFFF;
+        if (mask)
+            return ptr + __builtin_ctz(mask);
+        ptr += 16;
+    }
+    return skip_space_scalar(ptr, end);
+}
+
+__attribute__((target("avx2"))) static const char *
+scan_special_avx2(const char *ptr, const char *end)
+{
+    const __m256i quote = _mm256_set1_epi8('\"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(31);
+
+    while (end - ptr >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) ptr);
+        __m256i special = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+        unsigned mask = (unsigned) _mm256_movemask_epi8(special);
+        if (mask)
+            return ptr + __builtin_ctz(mask);
+        ptr += 32;
+    }
+    return scan_special_sse2(ptr, end);
+}
+
+__attribute__((target("avx2"))) static const char *
+skip_space_avx2(const char *ptr, const char *end)
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i space = _mm256_set1_epi8(31);
+
+    while (end - ptr >= 32) {
+        __m256i v = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i *) ptr), one);
+        unsigned mask = ~(unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(v, space), v));
+        if (mask)
+            return ptr + __builtin_ctz(mask);
+        ptr += 32;
+    }
+    return skip_space_sse2(ptr, end);
+}
+
+static const char *(*scan_special)(const char *ptr, const char *end) = scan_special_sse2;
+static const char *(*skip_space)(const char *ptr, const char *end) = skip_space_sse2;
+
+__attribute__((constructor)) static void
+cJSON_Select_Scanners(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_special = scan_special_avx2;
+        skip_space = skip_space_avx2;
+    }
+}
+#else
+#define scan_special scan_special_scalar
+#define skip_space skip_space_scalar
+#endif
+
+/* Find the closing quote of the string starting at str. *len receives the
+   number of bytes between the quotes, which is never less than the length
+   of the decoded string, and *escaped whether there are escapes to decode. */
+static const char *
+scan_string(const char *str, const parse_buffer *pb, size_t *len, int *escaped)
+{
+    const char *ptr = str + 1;
+
+    *escaped = 0;
+    if (peek(pb, str) != '\"')
+        return 0; /* not a string! */
+    for (;;) {
+        ptr = scan_special(ptr, pb->end);
+        if (ptr == pb->end || *ptr != '\\')
+            break;
+        if (pb->end - ptr < 2)
+            return 0; /* unterminated */
+        ptr += 2, *escaped = 1; /* Skip escaped quotes. */
+    }
+    if (peek(pb, ptr) != '\"')
+        return 0; /* unterminated */
+    *len = ptr - str - 1;
+    return ptr;
+}
+
+/* Decode the escaped text between ptr and the closing quote into out, and
+   return the end of the output. The output may overlap the text, as long
+   as it does not start after it. */
+static char *
+decode_string(const char *ptr, const char *close, const parse_buffer *pb, char *out)
+{
+    char *ptr2 = out;
+    unsigned uc;
+    int len;
+
+    while (ptr < close) {
+        if (*ptr != '\\') {
+            const char *run = (const char *) memchr(ptr, '\\', close - ptr);
+            if (!run)
+                run = close;
+            memmove(ptr2, ptr, run - ptr);
+            ptr2 += run - ptr;
+            ptr = run;
+        } else {
+            ptr++;
+            switch (*ptr) {
+            case 'b':*ptr2++ = '\b';
+                break;
+            case 'f':*ptr2++ = '\f';
+                break;
+            case 'n':*ptr2++ = '\n';
+                break;
+            case 'r':*ptr2++ = '\r';
+                break;
+            case 't':*ptr2++ = '\t';
+                break;
+            case 'u': /* transcode utf16 to utf8. DOES NOT SUPPORT SURROGATE PAIRS CORRECTLY. */
+                if (!parse_hex4(ptr + 1, pb, &uc))
+                    return 0;
+                len = 3;
+                if (uc < 0x80)
+                    len = 1;
+                else if (uc < 0x800)
+                    len = 2;
+                ptr2 += len;
+
+                switch (len) {
+                case 3:*--ptr2 = ((uc | 0x80) & 0xBF);
+                    uc >>= 6; /* fall through */
+                case 2:*--ptr2 = ((uc | 0x80) & 0xBF);
+                    uc >>= 6; /* fall through */
+                case 1:*--ptr2 = (uc | firstByteMark[len]); /* fall through */
+                }
+                ptr2 += len;
+                ptr += 4;
+                break;
+            default:*ptr2++ = *ptr;
+                break;
+            }
+            ptr++;
+        }
+    }
+    return ptr2;
+}
+
+static const char *
+parse_string(cJSON *item, const char *str, const parse_buffer *pb)
+{
+    const char *close;
+    char *out, *end;
+    size_t len;
+    int escaped;
+
+    close = scan_string(str, pb, &len, &escaped);
+    if (!close)
+        return 0;
+
+    /* In place the decoded string is never longer than the text, and the
+       terminator lands on the closing quote at the latest. */
+    if (pb->insitu) {
+        out = (char *) str + 1;
+        item->flags |= CJSON_VALUESTRING_BORROWED;
+    } else if (item->alloc_pool) {
+        out = cJSON_Pool_New_String(item->alloc_pool, len + 1);
+        item->flags |= CJSON_VALUESTRING_BORROWED;
+    } else {
+        out = (char *) cJSON_malloc(len + 1);
+    }
+    if (!out)
+        return 0;
+
+    if (!escaped) {
+        if (!pb->insitu)
+            memcpy(out, str + 1, len);
+        end = out + len;
+    } else if (!(end = decode_string(str + 1, close, pb, out))) {
+        if (!(item->flags & CJSON_VALUESTRING_BORROWED))
+            cJSON_free(out);
+        return 0;
+    }
+    *end = 0;
+    item->valuestring = out;
+    item->type = cJSON_String;
+    return close + 1;
+}
+
+/* Render the cstring provided to an escaped version that can be printed. */
+static int
+print_string_ptr(const char *str, printbuffer *p)
+{
+    const char *ptr, *end;
+    char *ptr2, *out;
+    size_t len;
+
+    if (!str)
+        return 1;
+    len = strlen(str);
+    end = str + len;
+    for (ptr = scan_special(str, end); ptr < end; ptr = scan_special(ptr + 1, end))
+        len++;
+
+    out = ensure(p, len + 2);
+    if (!out)
+        return 0;
+    ptr2 = out;
+    ptr = str;
+    *ptr2++ = '\"';
+    while (ptr < end) {
+        const char *run = scan_special(ptr, end);
+        memcpy(ptr2, ptr, run - ptr);
+        ptr2 += run - ptr;
+        ptr = run;
+        if (ptr == end)
+            break;
+        *ptr2++ = '\\';
+        switch (*ptr++) {
+        case '\\':*ptr2++ = '\\';
+            break;
+        case '\"':*ptr2++ = '\"';
+            break;
+        case '\b':*ptr2++ = 'b';
+            break;
+        case '\f':*ptr2++ = 'f';
+            break;
+        case '\n':*ptr2++ = 'n';
+            break;
+        case '\r':*ptr2++ = 'r';
+            break;
+        case '\t':*ptr2++ = 't';
+            break;
+        default:ptr2--;
+            break; /* eviscerate with prejudice. */
+        }
+    }
+    *ptr2++ = '\"';
+    p->offset += ptr2 - out;
+    return 1;
+}
+
+/* Invote print_string_ptr (which is useful) on an item. */
+static int
+print_string(cJSON *item, printbuffer *p)
+{
+    return print_string_ptr(item->valuestring, p);
+}
+
+/* The default limit of nesting of arrays and objects. */
+#ifndef CJSON_NESTING_LIMIT
+#define CJSON_NESTING_LIMIT 1000
+#endif
+
+static int cJSON_nesting_limit = CJSON_NESTING_LIMIT;
+
+void
+cJSON_SetNestingLimit(int limit)
+{
+    cJSON_nesting_limit = limit > 0 ? limit : CJSON_NESTING_LIMIT;
+}
+
+/* Diff and merge patch recurse once per level of nesting on the native
+   stack, so they stop at this limit even when the nesting limit is raised. */
+#ifndef CJSON_RECURSION_LIMIT
+#define CJSON_RECURSION_LIMIT 1000
+#endif
+
+static int
+recursion_limit(void)
+{
+    return cJSON_nesting_limit < CJSON_RECURSION_LIMIT ? cJSON_nesting_limit : CJSON_RECURSION_LIMIT;
+}
+
+/* The open arrays and objects of the parser and the printer. */
+typedef struct {
+    cJSON **items;
+    int depth;
+    int size;
+    cJSON *local[32];
+} item_stack;
+
+static void
+item_stack_init(item_stack *stack)
+{
+    stack->items = stack->local;
+    stack->depth = 0;
+    stack->size = (int) (sizeof(stack->local) / sizeof(stack->local[0]));
+}
+
+/* Returns 0 when the item would nest deeper than the limit, or out of memory. */
+static int
+item_stack_push(item_stack *stack, cJSON *item)
+{
+    if (stack->depth >= cJSON_nesting_limit)
+        return 0;
+    if (stack->depth == stack->size) {
+        cJSON **items = (cJSON **) cJSON_malloc(stack->size * 2 * sizeof(cJSON *));
+        if (!items)
+            return 0;
+        memcpy(items, stack->items, stack->depth * sizeof(cJSON *));
+        if (stack->items != stack->local)
+            cJSON_free(stack->items);
+        stack->items = items;
+        stack->size *= 2;
+    }
+    stack->items[stack->depth++] = item;
+    return 1;
+}
+
+static void
+item_stack_free(item_stack *stack)
+{
+    if (stack->items != stack->local)
+        cJSON_free(stack->items);
+}
+
+static const char *
+parse_value(cJSON *item, const char *value, const parse_buffer *pb);
+
+static int
+print_value(cJSON *item, int depth, int fmt, printbuffer *p);
+
+/* Utility to jump whitespace and cr/lf */
+static const char *
+skip(const char *in, const parse_buffer *pb)
+{
+    if (in && in < pb->end && *in && (unsigned char) *in <= 32)
+        in = skip_space(in + 1, pb->end);
+    return in;
+}
+
+static cJSON *
+parse_root_in(cJSON_Pool *pool, const char *value, const parse_buffer *pb, const char **return_parse_end,
+              int require_complete);
+
+/* Parse the whole input described by pb into a new tree. */
+static cJSON *
+parse_root(const char *value, const parse_buffer *pb, const char **return_parse_end, int require_complete)
+{
+    return parse_root_in(cJSON_New_Pool(pb->end - value), value, pb, return_parse_end, require_complete);
+}
+
+/* Parse into the given pool, or into malloc'd items when it is NULL. */
+static cJSON *
+parse_root_in(cJSON_Pool *pool, const char *value, const parse_buffer *pb, const char **return_parse_end,
+              int require_complete)
+{
+    cJSON *c = 0;
+    const char *end;
+    if (pool) {
+        c = cJSON_Pool_New_Item(pool);
     }
     if (!c) {
         c = cJSON_New_Item(0);
@@ -472,364 +1656,2226 @@ cJSON_Parse(const char *value)
     if (!c)
         return 0; /* memory fail */
 
-    c->alloc_pool = pool;
+    c->alloc_pool = pool;
+
+    end = parse_value(c, skip(value, pb), pb);
+    if (end && require_complete) {
+        end = skip(end, pb);
+        if (end < pb->end && *end)
+            end = 0; /* trailing garbage */
+    }
+    if (!end) {
+        cJSON_Delete(c);
+        return 0;
+    }
+    if (return_parse_end)
+        *return_parse_end = end;
+    return c;
+}
+
+/* Parse an object - create a new root, and populate. */
+cJSON *
+cJSON_Parse(const char *value)
+{
+    if (!value)
+        return 0;
+    return cJSON_ParseWithLengthOpts(value, strlen(value), 0, 0);
+}
+
+cJSON *
+cJSON_ParseWithLength(const char *value, size_t len)
+{
+    return cJSON_ParseWithLengthOpts(value, len, 0, 0);
+}
+
+cJSON *
+cJSON_ParseWithLengthOpts(const char *value, size_t len, const char **return_parse_end, int require_complete)
+{
+    parse_buffer pb;
+
+    if (!value)
+        return 0;
+    pb.end = value + len;
+    pb.insitu = 0;
+    return parse_root(value, &pb, return_parse_end, require_complete);
+}
+
+cJSON *
+cJSON_ParseInPlace(char *buf, size_t len)
+{
+    parse_buffer pb;
+
+    if (!buf)
+        return 0;
+    pb.end = buf + len;
+    pb.insitu = 1;
+    return parse_root(buf, &pb, 0, 0);
+}
+
+/* Render a cJSON item/entity/structure to text. */
+char *
+cJSON_Print(cJSON *item)
+{
+    return cJSON_PrintBuffered(item, 256, 1);
+}
+
+char *
+cJSON_PrintUnformatted(cJSON *item)
+{
+    return cJSON_PrintBuffered(item, 256, 0);
+}
+
+char *
+cJSON_PrintBuffered(cJSON *item, int prebuffer, int fmt)
+{
+    printbuffer p;
+
+    p.buffer = 0;
+    p.length = 0;
+    p.offset = 0;
+    p.noalloc = 0;
+    if (prebuffer > 0 && !ensure(&p, (size_t) prebuffer))
+        return 0;
+    if (!print_value(item, 0, fmt, &p) || !ensure(&p, 1)) {
+        cJSON_free(p.buffer);
+        return 0;
+    }
+    p.buffer[p.offset] = 0;
+    return p.buffer;
+}
+
+int
+cJSON_PrintPreallocated(cJSON *item, char *buffer, int length, int fmt)
+{
+    printbuffer p;
+
+    if (!buffer || length <= 0)
+        return 0;
+    p.buffer = buffer;
+    p.length = (size_t) length;
+    p.offset = 0;
+    p.noalloc = 1;
+    if (!print_value(item, 0, fmt, &p) || !ensure(&p, 1))
+        return 0;
+    p.buffer[p.offset] = 0;
+    return 1;
+}
+
+/* The initial buffer of NDJSON readers and writers, it only grows for lines
+   which do not fit. */
+#ifndef CJSON_NDJSON_BUFFER_SIZE
+#define CJSON_NDJSON_BUFFER_SIZE 65536
+#endif
+
+struct cJSON_NDJSONReader {
+    int fd; /* -1 when reading from memory */
+    int eof;
+    int failed;
+    size_t line;
+
+    /* the input, the unread part of it starts at pos */
+    char *buffer;
+    size_t pos;
+    size_t len;
+    size_t size;
+
+    /* the pool of the documents, the reader holds a reference to it */
+    cJSON_Pool *pool;
+    cJSON *document;
+};
+
+static cJSON_NDJSONReader *
+ndjson_reader_new(int fd)
+{
+    cJSON_NDJSONReader *reader = (cJSON_NDJSONReader *) cJSON_malloc(sizeof(cJSON_NDJSONReader));
+
+    if (!reader)
+        return 0;
+    memset(reader, 0, sizeof(cJSON_NDJSONReader));
+    reader->fd = fd;
+    if ((reader->pool = cJSON_New_Pool(CJSON_NDJSON_BUFFER_SIZE)))
+        reader->pool->refcount++;
+    return reader;
+}
+
+cJSON_NDJSONReader *
+cJSON_NDJSONReaderFromFd(int fd)
+{
+    cJSON_NDJSONReader *reader = ndjson_reader_new(fd);
+
+    if (reader && !(reader->buffer = (char *) cJSON_malloc(CJSON_NDJSON_BUFFER_SIZE))) {
+        cJSON_NDJSONReaderFree(reader);
+        return 0;
+    }
+    if (reader)
+        reader->size = CJSON_NDJSON_BUFFER_SIZE;
+    return reader;
+}
+
+cJSON_NDJSONReader *
+cJSON_NDJSONReaderFromMemory(const char *data, size_t len)
+{
+    cJSON_NDJSONReader *reader = ndjson_reader_new(-1);
+
+    if (reader) {
+        reader->buffer = (char *) data; /* never written to */
+        reader->len = reader->size = len;
+        reader->eof = 1;
+    }
+    return reader;
+}
+
+/* Drop the reference to the pool, which goes away with its last item. */
+static void
+ndjson_release_pool(cJSON_NDJSONReader *reader)
+{
+    if (reader->pool && --reader->pool->refcount == 0)
+        cJSON_Destroy_Pool(reader->pool);
+    reader->pool = 0;
+}
+
+/* Delete the last document. Its pool is reused when nothing of it is left,
+   otherwise the next documents go into a new one. */
+static void
+ndjson_drop_document(cJSON_NDJSONReader *reader)
+{
+    cJSON_Delete(reader->document);
+    reader->document = 0;
+    if (reader->pool && reader->pool->refcount == 1) {
+        cJSON_Trim_Pool(reader->pool);
+    } else {
+        ndjson_release_pool(reader);
+        if ((reader->pool = cJSON_New_Pool(CJSON_NDJSON_BUFFER_SIZE)))
+            reader->pool->refcount++;
+    }
+}
+
+/* Find the end of the next line, reading more of the file when it is not in
+   the buffer yet. Returns 0 at the end of the input or on error. */
+static const char *
+ndjson_next_line(cJSON_NDJSONReader *reader)
+{
+    size_t scanned = reader->pos;
+    const char *eol;
+
+    for (;;) {
+        if ((eol = (const char *) memchr(reader->buffer + scanned, '\n', reader->len - scanned)))
+            return eol;
+        if (reader->eof)
+            return reader->pos < reader->len ? reader->buffer + reader->len : 0;
+
+        /* move the partial line to the front, and make room behind it */
+        scanned = reader->len - reader->pos;
+        memmove(reader->buffer, reader->buffer + reader->pos, scanned);
+        reader->pos = 0;
+        reader->len = scanned;
+        if (reader->len == reader->size) {
+            char *grown = (char *) cJSON_malloc(reader->size * 2);
+            if (!grown) {
+                reader->failed = 1;
+                return 0;
+            }
+            memcpy(grown, reader->buffer, reader->len);
+            cJSON_free(reader->buffer);
+            reader->buffer = grown;
+            reader->size *= 2;
+        }
+        for (;;) {
+            size_t want = reader->size - reader->len;
+            long got = (long) cJSON_read(reader->fd, reader->buffer + reader->len,
+                                         (unsigned int) (want < 0x40000000 ? want : 0x40000000));
+            if (got > 0) {
+                reader->len += (size_t) got;
+            } else if (got == 0) {
+                reader->eof = 1;
+            } else if (errno == EINTR) {
+                continue;
+            } else {
+                reader->failed = 1;
+                return 0;
+            }
+            break;
+        }
+    }
+}
+
+cJSON *
+cJSON_NDJSONRead(cJSON_NDJSONReader *reader)
+{
+    const char *line, *eol;
+    parse_buffer pb;
+
+    if (!reader)
+        return 0;
+    if (reader->document || reader->failed == 2)
+        ndjson_drop_document(reader);
+    if (reader->failed == 2)
+        reader->failed = 0; /* a bad line does not stop the reader */
+    while (!reader->failed && (eol = ndjson_next_line(reader))) {
+        line = reader->buffer + reader->pos;
+        reader->pos = eol - reader->buffer + (eol < reader->buffer + reader->len);
+        reader->line++;
+        pb.end = eol;
+        pb.insitu = 0;
+        line = skip(line, &pb);
+        if (line == eol)
+            continue; /* blank */
+        if (!(reader->document = parse_root_in(reader->pool, line, &pb, 0, 1)))
+            reader->failed = 2;
+        return reader->document;
+    }
+    return 0;
+}
+
+int
+cJSON_NDJSONReaderFailed(const cJSON_NDJSONReader *reader)
+{
+    return !reader || reader->failed;
+}
+
+size_t
+cJSON_NDJSONReaderLine(const cJSON_NDJSONReader *reader)
+{
+    return reader ? reader->line : 0;
+}
+
+void
+cJSON_NDJSONReaderFree(cJSON_NDJSONReader *reader)
+{
+    if (!reader)
+        return;
+    cJSON_Delete(reader->document);
+    ndjson_release_pool(reader);
+    if (reader->fd >= 0)
+        cJSON_free(reader->buffer);
+    cJSON_free(reader);
+}
+
+struct cJSON_NDJSONWriter {
+    cJSON_NDJSONSink sink;
+    void *ctx;
+    int fd;
+    int failed;
+    size_t flush_size;
+    printbuffer p;
+};
+
+static int
+ndjson_write_fd(void *ctx, const char *data, size_t len)
+{
+    int fd = *(int *) ctx;
+
+    while (len) {
+        long done = (long) cJSON_write(fd, data, (unsigned int) (len < 0x40000000 ? len : 0x40000000));
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return 0;
+        data += done;
+        len -= (size_t) done;
+    }
+    return 1;
+}
+
+cJSON_NDJSONWriter *
+cJSON_NDJSONWriterNew(cJSON_NDJSONSink sink, void *ctx, size_t buffer_size)
+{
+    cJSON_NDJSONWriter *writer;
+
+    if (!sink)
+        return 0;
+    if (!buffer_size)
+        buffer_size = CJSON_NDJSON_BUFFER_SIZE;
+    writer = (cJSON_NDJSONWriter *) cJSON_malloc(sizeof(cJSON_NDJSONWriter));
+    if (!writer)
+        return 0;
+    memset(writer, 0, sizeof(cJSON_NDJSONWriter));
+    writer->sink = sink;
+    writer->ctx = ctx;
+    writer->fd = -1;
+    writer->flush_size = buffer_size;
+    if (!ensure(&writer->p, buffer_size + 1)) {
+        cJSON_free(writer);
+        return 0;
+    }
+    return writer;
+}
+
+cJSON_NDJSONWriter *
+cJSON_NDJSONWriterFromFd(int fd, size_t buffer_size)
+{
+    cJSON_NDJSONWriter *writer = cJSON_NDJSONWriterNew(ndjson_write_fd, 0, buffer_size);
+
+    if (writer) {
+        writer->fd = fd;
+        writer->ctx = &writer->fd;
+    }
+    return writer;
+}
+
+int
+cJSON_NDJSONWriterFlush(cJSON_NDJSONWriter *writer)
+{
+    if (!writer || writer->failed)
+        return 0;
+    if (writer->p.offset && !writer->sink(writer->ctx, writer->p.buffer, writer->p.offset))
+        writer->failed = 1;
+    writer->p.offset = 0;
+    return !writer->failed;
+}
+
+int
+cJSON_NDJSONWrite(cJSON_NDJSONWriter *writer, cJSON *item)
+{
+    size_t start;
+
+    if (!writer || writer->failed || !item)
+        return 0;
+    start = writer->p.offset;
+    if (!print_value(item, 0, 0, &writer->p) || !print_raw(&writer->p, "\n", 1)) {
+        if (!writer->p.buffer)
+            writer->failed = 1; /* out of memory, and the pending lines are lost */
+        writer->p.offset = start;
+        return 0;
+    }
+    if (writer->p.offset >= writer->flush_size)
+        return cJSON_NDJSONWriterFlush(writer);
+    return 1;
+}
+
+int
+cJSON_NDJSONWriterFree(cJSON_NDJSONWriter *writer)
+{
+    int ok;
+
+    if (!writer)
+        return 0;
+    ok = cJSON_NDJSONWriterFlush(writer);
+    cJSON_free(writer->p.buffer);
+    cJSON_free(writer);
+    return ok;
+}
+
+/* Turn the string just parsed into the item into its name. */
+static void
+name_from_value(cJSON *item)
+{
+    item->string = item->valuestring;
+    item->valuestring = 0;
+    if (item->flags & CJSON_VALUESTRING_BORROWED) {
+        item->flags &= ~CJSON_VALUESTRING_BORROWED;
+        item->flags |= CJSON_STRING_BORROWED;
+    }
+}
+
+/* Parse the name of the member item of an object, and the colon after it.
+   Returns the start of the value. */
+static const char *
+parse_name(cJSON *item, const char *value, const parse_buffer *pb)
+{
+    value = skip(parse_string(item, value, pb), pb);
+    if (!value)
+        return 0;
+    name_from_value(item);
+    if (peek(pb, value) != ':')
+        return 0; /* fail! */
+    return skip(value + 1, pb);
+}
+
+/* Parser core - when encountering text, process appropriately. Arrays and
+   objects are parsed in the same loop as the values inside them, keeping
+   the open ones on a stack instead of recursing. */
+static const char *
+parse_value(cJSON *item, const char *value, const parse_buffer *pb)
+{
+    item_stack stack;
+    cJSON *parent, *child;
+    size_t avail;
+    char close;
+
+    item_stack_init(&stack);
+    for (;;) {
+        /* parse the value of item */
+        if (!value)
+            goto fail; /* Fail on null. */
+        avail = pb->end - value;
+        switch (peek(pb, value)) {
+        case 'n':
+            if (avail < 4 || strncmp(value, "null", 4))
+                goto fail;
+            item->type = cJSON_NULL;
+            value += 4;
+            break;
+        case 'f':
+            if (avail < 5 || strncmp(value, "false", 5))
+                goto fail;
+            item->type = cJSON_False;
+            value += 5;
+            break;
+        case 't':
+            if (avail < 4 || strncmp(value, "true", 4))
+                goto fail;
+            item->type = cJSON_True;
+            item->valueint = 1;
+            value += 4;
+            break;
+        case '\"':
+            value = parse_string(item, value, pb);
+            break;
+        case '-':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+            value = parse_number(item, value, pb);
+            break;
+        case '[':
+        case '{':
+            item->type = *value == '[' ? cJSON_Array : cJSON_Object;
+            close = *value == '[' ? ']' : '}';
+            value = skip(value + 1, pb);
+            if (peek(pb, value) == close) {
+                value++; /* empty array or object. */
+                break;
+            }
+            if (!item_stack_push(&stack, item) || !(child = cJSON_New_Item(item)))
+                goto fail; /* too deep, or memory fail */
+            item->child = child;
+            item = child;
+            if (stack.items[stack.depth - 1]->type == cJSON_Object)
+                value = parse_name(item, value, pb);
+            continue;
+        default:
+            goto fail; /* failure. */
+        }
+        if (!value)
+            goto fail;
+
+        /* after the value, move on to the next element, closing the arrays
+           and objects which end here */
+        for (;;) {
+            if (!stack.depth) {
+                item_stack_free(&stack);
+                return value;
+            }
+            parent = stack.items[stack.depth - 1];
+            close = parent->type == cJSON_Array ? ']' : '}';
+            value = skip(value, pb);
+            if (peek(pb, value) == ',') {
+                if (!(child = cJSON_New_Item(parent)))
+                    goto fail; /* memory fail */
+                item->next = child;
+                child->prev = item;
+                item = child;
+                value = skip(value + 1, pb);
+                if (parent->type == cJSON_Object)
+                    value = parse_name(item, value, pb);
+                break;
+            }
+            if (peek(pb, value) != close)
+                goto fail; /* malformed. */
+            value++;
+            item = parent;
+            stack.depth--;
+        }
+    }
+
+fail:
+    item_stack_free(&stack);
+    return 0;
+}
+
+/* Indent with depth tabs. */
+static int
+print_indent(int depth, printbuffer *p)
+{
+    char *ptr = ensure(p, depth);
+    if (!ptr)
+        return 0;
+    memset(ptr, '\t', depth);
+    p->offset += depth;
+    return 1;
+}
+
+/* Print the indentation and the name of a member of an object. */
+static int
+print_name(cJSON *item, int depth, int fmt, printbuffer *p)
+{
+    return (!fmt || print_indent(depth, p)) && print_string_ptr(item->string, p) &&
+           print_raw(p, ":\t", fmt ? 2 : 1);
+}
+
+/* Render a value to text. Like the parser, the printer keeps the open
+   arrays and objects on a stack instead of recursing; depth is the nesting
+   of item. */
+static int
+print_value(cJSON *item, int depth, int fmt, printbuffer *p)
+{
+    item_stack stack;
+    cJSON *parent;
+    int ok;
+
+    if (!item)
+        return 0;
+    item_stack_init(&stack);
+    for (;;) {
+        switch ((item->type) & 255) {
+        case cJSON_NULL:ok = print_raw(p, "null", 4);
+            break;
+        case cJSON_False:ok = print_raw(p, "false", 5);
+            break;
+        case cJSON_True:ok = print_raw(p, "true", 4);
+            break;
+        case cJSON_Number:ok = print_number(item, p);
+            break;
+        case cJSON_String:ok = print_string(item, p);
+            break;
+        case cJSON_Array:
+            if (!print_raw(p, "[", 1))
+                goto fail;
+            if (item->child) {
+                if (!item_stack_push(&stack, item))
+                    goto fail;
+                item = item->child;
+                continue;
+            }
+            ok = print_raw(p, "]", 1);
+            break;
+        case cJSON_Object:
+            if (!print_raw(p, "{\n", fmt ? 2 : 1))
+                goto fail;
+            if (item->child) {
+                if (!item_stack_push(&stack, item))
+                    goto fail;
+                item = item->child;
+                if (!print_name(item, depth + stack.depth, fmt, p))
+                    goto fail;
+                continue;
+            }
+            ok = (!fmt || print_indent(depth + stack.depth, p)) && print_raw(p, "}", 1);
+            break;
+        default:ok = 0;
+            break;
+        }
+        if (!ok)
+            goto fail;
+
+        /* after the value, print the separator and move on to the next
+           element, closing the arrays and objects which end here */
+        for (;;) {
+            if (!stack.depth) {
+                item_stack_free(&stack);
+                return 1;
+            }
+            parent = stack.items[stack.depth - 1];
+            if ((parent->type & 255) == cJSON_Array) {
+                if (item->next) {
+                    if (!print_raw(p, ", ", fmt ? 2 : 1))
+                        goto fail;
+                    item = item->next;
+                    break;
+                }
+                if (!print_raw(p, "]", 1))
+                    goto fail;
+            } else {
+                if ((item->next && !print_raw(p, ",", 1)) || (fmt && !print_raw(p, "\n", 1)))
+                    goto fail;
+                if (item->next) {
+                    item = item->next;
+                    if (!print_name(item, depth + stack.depth, fmt, p))
+                        goto fail;
+                    break;
+                }
+                if ((fmt && !print_indent(depth + stack.depth - 1, p)) || !print_raw(p, "}", 1))
+                    goto fail;
+            }
+            item = parent;
+            stack.depth--;
+        }
+    }
+
+fail:
+    item_stack_free(&stack);
+    return 0;
+}
+
+/* Growable buffer for the strings handed to SAX callbacks, keeps its
+   contents when it grows. */
+typedef struct {
+    char *buf;
+    size_t size;
+} sax_scratch;
+
+static char *
+sax_reserve(sax_scratch *scratch, size_t len)
+{
+    if (scratch->size < len) {
+        size_t size = scratch->size ? scratch->size : 64;
+        char *buf;
+        while (size < len)
+            size *= 2;
+        if (!(buf = (char *) cJSON_malloc(size)))
+            return 0;
+        if (scratch->buf) {
+            memcpy(buf, scratch->buf, scratch->size);
+            cJSON_free(scratch->buf);
+        }
+        scratch->buf = buf;
+        scratch->size = size;
+    }
+    return scratch->buf;
+}
+
+/* Lex the string at str. Strings without escapes are handed out straight
+   from the input, the others are decoded into the scratch buffer. */
+static const char *
+sax_string(const char *str, const parse_buffer *pb, sax_scratch *scratch, const char **out, size_t *outlen)
+{
+    const char *close;
+    char *end;
+    size_t len;
+    int escaped;
+
+    close = scan_string(str, pb, &len, &escaped);
+    if (!close)
+        return 0;
+    if (!escaped) {
+        *out = str + 1;
+        *outlen = len;
+        return close + 1;
+    }
+    if (!sax_reserve(scratch, len + 1) || !(end = decode_string(str + 1, close, pb, scratch->buf)))
+        return 0;
+    *end = 0;
+    *out = scratch->buf;
+    *outlen = end - scratch->buf;
+    return close + 1;
+}
+
+static int
+sax_literal(const char *value, const parse_buffer *pb, const char *literal, size_t len)
+{
+    return (size_t) (pb->end - value) >= len && !strncmp(value, literal, len);
+}
+
+/* States of the SAX parser. */
+#define SAX_VALUE 0 /* expecting a value */
+#define SAX_NEXT 1  /* after a value */
+#define SAX_KEY 2   /* expecting a member name */
+#define SAX_DONE 3
+#define SAX_FAIL 4
+
+int
+cJSON_ParseSAX(const char *value, size_t len, const cJSON_SAXHandler *handler, void *ctx)
+{
+    parse_buffer pb;
+    sax_scratch scratch = {0, 0};
+    char local[64], *stack = local, *grown; /* the open containers, '{' or '[' */
+    size_t depth = 0, cap = sizeof(local), slen;
+    const char *str, *end;
+    double num;
+    int64_t integer;
+    int exact;
+    int state = SAX_VALUE;
+
+    if (!value || !handler)
+        return 0;
+    pb.end = value + len;
+    pb.insitu = 0;
+    value = skip(value, &pb);
+
+#define SAX_EMIT(cb, args) (!handler->cb || handler->cb args)
+    while (state != SAX_DONE && state != SAX_FAIL) {
+        switch (state) {
+        case SAX_VALUE:
+            state = SAX_NEXT;
+            switch (peek(&pb, value)) {
+            case '{':
+            case '[':
+                if (depth >= (size_t) cJSON_nesting_limit) {
+                    state = SAX_FAIL; /* too deep */
+                    break;
+                }
+                if (depth == cap) {
+                    if (!(grown = (char *) cJSON_malloc(cap * 2))) {
+                        state = SAX_FAIL;
+                        break;
+                    }
+                    memcpy(grown, stack, depth);
+                    if (stack != local)
+                        cJSON_free(stack);
+                    stack = grown;
+                    cap *= 2;
+                }
+                stack[depth++] = *value;
+                if (*value == '{' ? !SAX_EMIT(start_object, (ctx)) : !SAX_EMIT(start_array, (ctx))) {
+                    state = SAX_FAIL;
+                    break;
+                }
+                value = skip(value + 1, &pb);
+                if (peek(&pb, value) == (stack[depth - 1] == '{' ? '}' : ']'))
+                    break; /* empty, SAX_NEXT closes it */
+                state = stack[depth - 1] == '{' ? SAX_KEY : SAX_VALUE;
+                break;
+            case '\"':
+                value = sax_string(value, &pb, &scratch, &str, &slen);
+                if (!value || !SAX_EMIT(string, (ctx, str, slen)))
+                    state = SAX_FAIL;
+                break;
+            case 'n':
+                if (!sax_literal(value, &pb, "null", 4) || !SAX_EMIT(null, (ctx)))
+                    state = SAX_FAIL;
+                value += 4;
+                break;
+            case 't':
+                if (!sax_literal(value, &pb, "true", 4) || !SAX_EMIT(boolean, (ctx, 1)))
+                    state = SAX_FAIL;
+                value += 4;
+                break;
+            case 'f':
+                if (!sax_literal(value, &pb, "false", 5) || !SAX_EMIT(boolean, (ctx, 0)))
+                    state = SAX_FAIL;
+                value += 5;
+                break;
+            case '-':
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9':
+                end = lex_number(value, &pb, &num, &integer, &exact);
+                if (exact && handler->integer ? !handler->integer(ctx, integer)
+                                              : !SAX_EMIT(number, (ctx, num, value, end - value)))
+                    state = SAX_FAIL;
+                value = end;
+                break;
+            default:
+                state = SAX_FAIL;
+                break;
+            }
+            break;
+
+        case SAX_NEXT:
+            if (!depth) {
+                state = SAX_DONE;
+                break;
+            }
+            value = skip(value, &pb);
+            if (peek(&pb, value) == ',') {
+                value = skip(value + 1, &pb);
+                state = stack[depth - 1] == '{' ? SAX_KEY : SAX_VALUE;
+            } else if (peek(&pb, value) == '}' && stack[depth - 1] == '{') {
+                depth--;
+                value++;
+                if (!SAX_EMIT(end_object, (ctx)))
+                    state = SAX_FAIL;
+            } else if (peek(&pb, value) == ']' && stack[depth - 1] == '[') {
+                depth--;
+                value++;
+                if (!SAX_EMIT(end_array, (ctx)))
+                    state = SAX_FAIL;
+            } else {
+                state = SAX_FAIL; /* malformed. */
+            }
+            break;
+
+        case SAX_KEY:
+            value = sax_string(value, &pb, &scratch, &str, &slen);
+            if (!value || !SAX_EMIT(key, (ctx, str, slen))) {
+                state = SAX_FAIL;
+                break;
+            }
+            value = skip(value, &pb);
+            if (peek(&pb, value) != ':') {
+                state = SAX_FAIL;
+                break;
+            }
+            value = skip(value + 1, &pb);
+            state = SAX_VALUE;
+            break;
+        }
+    }
+#undef SAX_EMIT
+
+    cJSON_free(scratch.buf);
+    if (stack != local)
+        cJSON_free(stack);
+    return state == SAX_DONE;
+}
+
+/* Steps of compiled filter path. */
+#define FILTER_KEY 0   /* .name */
+#define FILTER_INDEX 1 /* [N] */
+#define FILTER_ANY 2   /* [] */
+
+typedef struct {
+    int kind;
+    int index;
+    const char *name;
+    size_t len;
+} filter_step;
+
+/* An open container on the way to the current value. */
+typedef struct {
+    int type;     /* cJSON_Object or cJSON_Array */
+    int index;    /* position of the current element of an array */
+    size_t key;   /* offset of the current name in the names buffer */
+    size_t keylen;
+} filter_level;
+
+typedef struct {
+    cJSON_FilterCallback callback;
+    void *ctx;
+
+    /* steps of all paths, path i takes steps from path_start[i] up to
+       path_start[i + 1] */
+    filter_step *steps;
+    int *path_start;
+    int npaths;
+
+    filter_level *levels;
+    int depth, cap;
+
+    /* the names of the levels, NUL-terminated one after another */
+    sax_scratch names;
+    size_t names_len;
+
+    /* NUL-terminated copy of the current string value */
+    sax_scratch value;
+} filter_state;
+
+/* Count the steps of path, and when steps is not NULL, fill them in. */
+static int
+filter_compile(const char *path, filter_step *steps)
+{
+    int n = 0;
+    filter_step step;
+
+    while (*path) {
+        if (*path == '.') {
+            path++;
+            continue;
+        }
+        if (*path == '[') {
+            path++;
+            if (*path == ']') {
+                step.kind = FILTER_ANY;
+                step.index = 0;
+            } else {
+                step.kind = FILTER_INDEX;
+                step.index = 0;
+                if (*path < '0' || *path > '9')
+                    return -1;
+                while (*path >= '0' && *path <= '9')
+                    step.index = step.index * 10 + (*path++ - '0');
+                if (*path != ']')
+                    return -1;
+            }
+            path++;
+            step.name = 0;
+            step.len = 0;
+        } else {
+            step.kind = FILTER_KEY;
+            step.index = 0;
+            step.name = path;
+            while (*path && *path != '.' && *path != '[')
+                path++;
+            step.len = path - step.name;
+        }
+        if (steps)
+            steps[n] = step;
+        n++;
+    }
+    return n;
+}
+
+/* Account for a new value in the innermost container. */
+static void
+filter_enter_value(filter_state *f)
+{
+    if (f->depth && f->levels[f->depth - 1].type == cJSON_Array)
+        f->levels[f->depth - 1].index++;
+}
+
+/* Tell whether the current value sits at the end of the path. */
+static int
+filter_match(const filter_state *f, int path)
+{
+    const filter_step *steps = f->steps + f->path_start[path];
+    int i;
+
+    if (f->path_start[path + 1] - f->path_start[path] != f->depth)
+        return 0;
+    for (i = 0; i < f->depth; i++) {
+        const filter_level *level = f->levels + i;
+        if (steps[i].kind == FILTER_KEY) {
+            if (level->type != cJSON_Object || level->keylen != steps[i].len ||
+                memcmp(f->names.buf + level->key, steps[i].name, steps[i].len))
+                return 0;
+        } else if (level->type != cJSON_Array ||
+                   (steps[i].kind == FILTER_INDEX && level->index != steps[i].index)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Hand the scalar value to the callback of every matching path. */
+static int
+filter_scalar(filter_state *f, int type, const cJSON *number, const char *str, size_t len)
+{
+    cJSON item;
+    int i, element = -1, filled = 0;
+
+    filter_enter_value(f);
+    for (i = 0; i < f->npaths; i++) {
+        if (!filter_match(f, i))
+            continue;
+        if (!filled) {
+            memset(&item, 0, sizeof(item));
+            item.type = type;
+            if (type == cJSON_Number) {
+                item.valuedouble = number->valuedouble;
+                item.valueint = number->valueint;
+                item.valueint64 = number->valueint64;
+                item.flags = number->flags;
+            } else if (type == cJSON_True) {
+                item.valueint = 1;
+            } else if (type == cJSON_String) {
+                if (!sax_reserve(&f->value, len + 1))
+                    return 0;
+                memcpy(f->value.buf, str, len);
+                f->value.buf[len] = 0;
+                item.valuestring = f->value.buf;
+            }
+            if (f->depth && f->levels[f->depth - 1].type == cJSON_Object)
+                item.string = f->names.buf + f->levels[f->depth - 1].key;
+            for (element = f->depth - 1; element >= 0; element--) {
+                if (f->levels[element].type == cJSON_Array) {
+                    element = f->levels[element].index;
+                    break;
+                }
+            }
+            filled = 1;
+        }
+        if (!f->callback(f->ctx, i, element, &item))
+            return 0;
+    }
+    return 1;
+}
+
+static int
+filter_start(void *ctx, int type)
+{
+    filter_state *f = (filter_state *) ctx;
+    filter_level *level;
+
+    filter_enter_value(f);
+    if (f->depth == f->cap) {
+        int cap = f->cap ? f->cap * 2 : 16;
+        filter_level *levels = (filter_level *) cJSON_malloc(cap * sizeof(filter_level));
+        if (!levels)
+            return 0;
+        if (f->levels) {
+            memcpy(levels, f->levels, f->depth * sizeof(filter_level));
+            cJSON_free(f->levels);
+        }
+        f->levels = levels;
+        f->cap = cap;
+    }
+    level = f->levels + f->depth++;
+    level->type = type;
+    level->index = -1;
+    level->key = f->names_len;
+    level->keylen = 0;
+    return 1;
+}
+
+static int
+filter_start_object(void *ctx)
+{
+    return filter_start(ctx, cJSON_Object);
+}
+
+static int
+filter_start_array(void *ctx)
+{
+    return filter_start(ctx, cJSON_Array);
+}
+
+static int
+filter_end(void *ctx)
+{
+    filter_state *f = (filter_state *) ctx;
+    f->names_len = f->levels[--f->depth].key;
+    return 1;
+}
+
+static int
+filter_key(void *ctx, const char *str, size_t len)
+{
+    filter_state *f = (filter_state *) ctx;
+    filter_level *level = f->levels + f->depth - 1;
+
+    /* the name replaces the previous one of the same level, which is always
+       the last in the buffer */
+    if (!sax_reserve(&f->names, level->key + len + 1)) {
+        return 0;
+    }
+    memcpy(f->names.buf + level->key, str, len);
+    f->names.buf[level->key + len] = 0;
+    level->keylen = len;
+    f->names_len = level->key + len + 1;
+    return 1;
+}
+
+static int
+filter_string(void *ctx, const char *str, size_t len)
+{
+    return filter_scalar((filter_state *) ctx, cJSON_String, 0, str, len);
+}
+
+static int
+filter_number(void *ctx, double num, const char *str, size_t len)
+{
+    cJSON number;
+
+    (void) str;
+    (void) len;
+    number.flags = 0;
+    set_number(&number, num);
+    return filter_scalar((filter_state *) ctx, cJSON_Number, &number, 0, 0);
+}
+
+static int
+filter_integer(void *ctx, int64_t num)
+{
+    cJSON number;
+
+    number.flags = 0;
+    set_int64(&number, num);
+    return filter_scalar((filter_state *) ctx, cJSON_Number, &number, 0, 0);
+}
+
+static int
+filter_boolean(void *ctx, int value)
+{
+    return filter_scalar((filter_state *) ctx, value ? cJSON_True : cJSON_False, 0, 0, 0);
+}
+
+static int
+filter_null(void *ctx)
+{
+    return filter_scalar((filter_state *) ctx, cJSON_NULL, 0, 0, 0);
+}
+
+int
+cJSON_Filter(const char *value, size_t len, const char **paths, int npaths, cJSON_FilterCallback callback, void *ctx)
+{
+    static const cJSON_SAXHandler handler = {filter_start_object, filter_end, filter_start_array, filter_end,
+                                             filter_key, filter_string, filter_number, filter_boolean,
+                                             filter_null, filter_integer};
+    filter_state f;
+    int i, n, total = 0, rc = 0;
+
+    if (!paths || npaths <= 0 || !callback)
+        return 0;
+    memset(&f, 0, sizeof(f));
+    f.callback = callback;
+    f.ctx = ctx;
+    f.npaths = npaths;
+
+    for (i = 0; i < npaths; i++) {
+        if ((n = filter_compile(paths[i], 0)) < 0)
+            return 0;
+        total += n;
+    }
+    f.steps = (filter_step *) cJSON_malloc((total ? total : 1) * sizeof(filter_step));
+    f.path_start = (int *) cJSON_malloc((npaths + 1) * sizeof(int));
+    if (f.steps && f.path_start) {
+        for (i = 0, total = 0; i < npaths; i++) {
+            f.path_start[i] = total;
+            total += filter_compile(paths[i], f.steps + total);
+        }
+        f.path_start[npaths] = total;
+        rc = cJSON_ParseSAX(value, len, &handler, &f);
+    }
+
+    cJSON_free(f.steps);
+    cJSON_free(f.path_start);
+    cJSON_free(f.levels);
+    cJSON_free(f.names.buf);
+    cJSON_free(f.value.buf);
+    return rc;
+}
+
+/* The tape is an array of 64-bit entries, the tag in the top byte and a
+   payload below. Strings and numbers take a second entry, with the length
+   of the string, or the bits of the number. The start entry of an array or
+   object holds the index right after its end entry in the low 32 bits and
+   the number of elements above them; the end entry holds the index of the
+   start. Object members are a key entry followed by the value. */
+#define TAPE_NULL 'n'
+#define TAPE_TRUE 't'
+#define TAPE_FALSE 'f'
+#define TAPE_INT64 'l'
+#define TAPE_DOUBLE 'd'
+#define TAPE_STRING '\"'
+#define TAPE_KEY 'k'
+#define TAPE_ARRAY '['
+#define TAPE_ARRAY_END ']'
+#define TAPE_OBJECT '{'
+#define TAPE_OBJECT_END '}'
+
+#define TAPE_TAG(entry) ((int) ((entry) >> 56))
+#define TAPE_PAYLOAD(entry) ((entry) & 0x00FFFFFFFFFFFFFFULL)
+#define TAPE_ENTRY(tag, payload) (((uint64_t) (tag) << 56) | (payload))
+#define TAPE_COUNT_MAX 0xFFFFFF /* larger containers are counted by walking */
+
+struct cJSON_Tape {
+    uint64_t *entries;
+    size_t count;
+    size_t size;
+
+    /* the decoded strings, each NUL-terminated */
+    char *strings;
+    size_t strings_len;
+    size_t strings_size;
+};
+
+typedef struct {
+    cJSON_Tape *tape;
+    sax_scratch open; /* indices of the open arrays and objects */
+    size_t depth;
+} tape_builder;
+
+static int
+tape_grow(void **buf, size_t *size, size_t needed, size_t unit)
+{
+    size_t newsize = *size ? *size : needed;
+    void *newbuf;
+
+    while (newsize < needed)
+        newsize *= 2;
+    if (!(newbuf = cJSON_malloc(newsize * unit)))
+        return 0;
+    if (*buf) {
+        memcpy(newbuf, *buf, *size * unit);
+        cJSON_free(*buf);
+    }
+    *buf = newbuf;
+    *size = newsize;
+    return 1;
+}
+
+/* Append n entries, the first one tagged, and return the index of it. */
+static size_t
+tape_append(tape_builder *b, int tag, uint64_t payload, int n)
+{
+    cJSON_Tape *tape = b->tape;
+    size_t index = tape->count;
+
+    if (tape->count + n > tape->size &&
+        !tape_grow((void **) &tape->entries, &tape->size, tape->count + n, sizeof(uint64_t)))
+        return CJSON_TAPE_NONE;
+    tape->entries[tape->count++] = TAPE_ENTRY(tag, payload);
+    if (n == 2)
+        tape->count++;
+    return index;
+}
+
+/* Count a new element in the innermost array, object members are counted
+   by their keys. */
+static void
+tape_element(tape_builder *b, int tag)
+{
+    uint64_t *start;
+
+    if (!b->depth)
+        return;
+    start = b->tape->entries + ((size_t *) b->open.buf)[b->depth - 1];
+    if ((TAPE_TAG(*start) == TAPE_ARRAY) == (tag != TAPE_KEY) && ((*start >> 32) & TAPE_COUNT_MAX) < TAPE_COUNT_MAX)
+        *start += (uint64_t) 1 << 32;
+}
+
+static int
+tape_start(void *ctx, int tag)
+{
+    tape_builder *b = (tape_builder *) ctx;
+    size_t index;
+
+    tape_element(b, tag);
+    if ((index = tape_append(b, tag, 0, 1)) == CJSON_TAPE_NONE ||
+        !sax_reserve(&b->open, (b->depth + 1) * sizeof(size_t)))
+        return 0;
+    ((size_t *) b->open.buf)[b->depth++] = index;
+    return 1;
+}
+
+static int
+tape_start_object(void *ctx)
+{
+    return tape_start(ctx, TAPE_OBJECT);
+}
+
+static int
+tape_start_array(void *ctx)
+{
+    return tape_start(ctx, TAPE_ARRAY);
+}
+
+static int
+tape_end(void *ctx, int tag)
+{
+    tape_builder *b = (tape_builder *) ctx;
+    size_t start = ((size_t *) b->open.buf)[--b->depth];
+    size_t index = tape_append(b, tag, start, 1);
+
+    if (index == CJSON_TAPE_NONE || index + 1 > 0xFFFFFFFFU)
+        return 0; /* the tape is limited to 2^32 entries */
+    b->tape->entries[start] |= index + 1;
+    return 1;
+}
+
+static int
+tape_end_object(void *ctx)
+{
+    return tape_end(ctx, TAPE_OBJECT_END);
+}
+
+static int
+tape_end_array(void *ctx)
+{
+    return tape_end(ctx, TAPE_ARRAY_END);
+}
+
+static int
+tape_text(tape_builder *b, int tag, const char *str, size_t len)
+{
+    cJSON_Tape *tape = b->tape;
+    size_t index;
+
+    tape_element(b, tag);
+    if (tape->strings_len + len + 1 > tape->strings_size &&
+        !tape_grow((void **) &tape->strings, &tape->strings_size, tape->strings_len + len + 1, 1))
+        return 0;
+    if ((index = tape_append(b, tag, tape->strings_len, 2)) == CJSON_TAPE_NONE)
+        return 0;
+    tape->entries[index + 1] = len;
+    memcpy(tape->strings + tape->strings_len, str, len);
+    tape->strings[tape->strings_len + len] = 0;
+    tape->strings_len += len + 1;
+    return 1;
+}
+
+static int
+tape_key(void *ctx, const char *str, size_t len)
+{
+    return tape_text((tape_builder *) ctx, TAPE_KEY, str, len);
+}
+
+static int
+tape_string(void *ctx, const char *str, size_t len)
+{
+    return tape_text((tape_builder *) ctx, TAPE_STRING, str, len);
+}
+
+static int
+tape_number(void *ctx, double num, const char *str, size_t len)
+{
+    tape_builder *b = (tape_builder *) ctx;
+    size_t index;
+
+    (void) str;
+    (void) len;
+    tape_element(b, TAPE_DOUBLE);
+    if ((index = tape_append(b, TAPE_DOUBLE, 0, 2)) == CJSON_TAPE_NONE)
+        return 0;
+    memcpy(b->tape->entries + index + 1, &num, sizeof(num));
+    return 1;
+}
+
+static int
+tape_integer(void *ctx, int64_t num)
+{
+    tape_builder *b = (tape_builder *) ctx;
+    size_t index;
+
+    tape_element(b, TAPE_INT64);
+    if ((index = tape_append(b, TAPE_INT64, 0, 2)) == CJSON_TAPE_NONE)
+        return 0;
+    b->tape->entries[index + 1] = (uint64_t) num;
+    return 1;
+}
+
+static int
+tape_boolean(void *ctx, int value)
+{
+    tape_builder *b = (tape_builder *) ctx;
+    int tag = value ? TAPE_TRUE : TAPE_FALSE;
+
+    tape_element(b, tag);
+    return tape_append(b, tag, 0, 1) != CJSON_TAPE_NONE;
+}
+
+static int
+tape_null(void *ctx)
+{
+    tape_builder *b = (tape_builder *) ctx;
+
+    tape_element(b, TAPE_NULL);
+    return tape_append(b, TAPE_NULL, 0, 1) != CJSON_TAPE_NONE;
+}
+
+cJSON_Tape *
+cJSON_ParseTape(const char *value, size_t len)
+{
+    static const cJSON_SAXHandler handler = {tape_start_object, tape_end_object, tape_start_array, tape_end_array,
+                                             tape_key, tape_string, tape_number, tape_boolean,
+                                             tape_null, tape_integer};
+    tape_builder b;
+
+    if (!value)
+        return 0;
+    if (!(b.tape = (cJSON_Tape *) cJSON_malloc(sizeof(cJSON_Tape))))
+        return 0;
+    memset(b.tape, 0, sizeof(cJSON_Tape));
+    b.open.buf = 0;
+    b.open.size = 0;
+    b.depth = 0;
+
+    /* About one entry per three bytes of text, and half as many bytes of
+       strings as of text, saves most of the regrowing. */
+    if (!tape_grow((void **) &b.tape->entries, &b.tape->size, len / 3 + 16, sizeof(uint64_t)) ||
+        !tape_grow((void **) &b.tape->strings, &b.tape->strings_size, len / 2 + 16, 1) ||
+        !cJSON_ParseSAX(value, len, &handler, &b)) {
+        cJSON_free(b.open.buf);
+        cJSON_DeleteTape(b.tape);
+        return 0;
+    }
+    cJSON_free(b.open.buf);
+    return b.tape;
+}
+
+void
+cJSON_DeleteTape(cJSON_Tape *tape)
+{
+    if (!tape)
+        return;
+    cJSON_free(tape->entries);
+    cJSON_free(tape->strings);
+    cJSON_free(tape);
+}
+
+/* The index right after the value. */
+static size_t
+tape_skip(const cJSON_Tape *tape, size_t value)
+{
+    uint64_t entry = tape->entries[value];
+
+    switch (TAPE_TAG(entry)) {
+    case TAPE_ARRAY:
+    case TAPE_OBJECT:return (size_t) (entry & 0xFFFFFFFFU);
+    case TAPE_INT64:
+    case TAPE_DOUBLE:
+    case TAPE_STRING:
+    case TAPE_KEY:return value + 2;
+    }
+    return value + 1;
+}
+
+static int
+tape_valid(const cJSON_Tape *tape, size_t value)
+{
+    return tape && value < tape->count;
+}
+
+int
+cJSON_TapeType(const cJSON_Tape *tape, size_t value)
+{
+    if (!tape_valid(tape, value))
+        return -1;
+    switch (TAPE_TAG(tape->entries[value])) {
+    case TAPE_NULL:return cJSON_NULL;
+    case TAPE_TRUE:return cJSON_True;
+    case TAPE_FALSE:return cJSON_False;
+    case TAPE_INT64:
+    case TAPE_DOUBLE:return cJSON_Number;
+    case TAPE_STRING:return cJSON_String;
+    case TAPE_ARRAY:return cJSON_Array;
+    case TAPE_OBJECT:return cJSON_Object;
+    }
+    return -1;
+}
+
+size_t
+cJSON_TapeChild(const cJSON_Tape *tape, size_t value)
+{
+    if (!tape_valid(tape, value))
+        return CJSON_TAPE_NONE;
+    switch (TAPE_TAG(tape->entries[value])) {
+    case TAPE_ARRAY:return TAPE_TAG(tape->entries[value + 1]) == TAPE_ARRAY_END ? CJSON_TAPE_NONE : value + 1;
+    case TAPE_OBJECT:return TAPE_TAG(tape->entries[value + 1]) == TAPE_OBJECT_END ? CJSON_TAPE_NONE : value + 3;
+    }
+    return CJSON_TAPE_NONE;
+}
+
+size_t
+cJSON_TapeNext(const cJSON_Tape *tape, size_t value)
+{
+    size_t next;
+
+    if (!tape_valid(tape, value))
+        return CJSON_TAPE_NONE;
+    next = tape_skip(tape, value);
+    if (next >= tape->count)
+        return CJSON_TAPE_NONE; /* the root has no siblings */
+    switch (TAPE_TAG(tape->entries[next])) {
+    case TAPE_KEY:return next + 2;
+    case TAPE_ARRAY_END:
+    case TAPE_OBJECT_END:return CJSON_TAPE_NONE;
+    }
+    return next;
+}
+
+int
+cJSON_TapeGetArraySize(const cJSON_Tape *tape, size_t value)
+{
+    uint64_t entry;
+    int count = 0;
+
+    if (!tape_valid(tape, value))
+        return 0;
+    entry = tape->entries[value];
+    if (TAPE_TAG(entry) != TAPE_ARRAY && TAPE_TAG(entry) != TAPE_OBJECT)
+        return 0;
+    if (((entry >> 32) & TAPE_COUNT_MAX) < TAPE_COUNT_MAX)
+        return (int) ((entry >> 32) & TAPE_COUNT_MAX);
+    for (value = cJSON_TapeChild(tape, value); value != CJSON_TAPE_NONE; value = cJSON_TapeNext(tape, value))
+        count++;
+    return count;
+}
+
+size_t
+cJSON_TapeGetArrayItem(const cJSON_Tape *tape, size_t array, int which)
+{
+    size_t value = cJSON_TapeChild(tape, array);
+    while (value != CJSON_TAPE_NONE && which-- > 0)
+        value = cJSON_TapeNext(tape, value);
+    return value;
+}
+
+static size_t
+tape_get_object_item(const cJSON_Tape *tape, size_t object, const char *name, int case_sensitive)
+{
+    size_t key;
+
+    if (!tape_valid(tape, object) || TAPE_TAG(tape->entries[object]) != TAPE_OBJECT || !name)
+        return CJSON_TAPE_NONE;
+    for (key = object + 1; TAPE_TAG(tape->entries[key]) == TAPE_KEY; key = tape_skip(tape, key + 2)) {
+        const char *str = tape->strings + TAPE_PAYLOAD(tape->entries[key]);
+        if (case_sensitive ? !strcmp(str, name) : !cJSON_strcasecmp(str, name))
+            return key + 2;
+    }
+    return CJSON_TAPE_NONE;
+}
+
+size_t
+cJSON_TapeGetObjectItem(const cJSON_Tape *tape, size_t object, const char *name)
+{
+    return tape_get_object_item(tape, object, name, 0);
+}
+
+size_t
+cJSON_TapeGetObjectItemCaseSensitive(const cJSON_Tape *tape, size_t object, const char *name)
+{
+    return tape_get_object_item(tape, object, name, 1);
+}
+
+const char *
+cJSON_TapeGetName(const cJSON_Tape *tape, size_t member)
+{
+    if (!tape_valid(tape, member) || member < 2 || TAPE_TAG(tape->entries[member - 2]) != TAPE_KEY)
+        return 0;
+    return tape->strings + TAPE_PAYLOAD(tape->entries[member - 2]);
+}
+
+const char *
+cJSON_TapeGetString(const cJSON_Tape *tape, size_t value, size_t *len)
+{
+    if (!tape_valid(tape, value) || TAPE_TAG(tape->entries[value]) != TAPE_STRING)
+        return 0;
+    if (len)
+        *len = (size_t) tape->entries[value + 1];
+    return tape->strings + TAPE_PAYLOAD(tape->entries[value]);
+}
+
+double
+cJSON_TapeGetNumber(const cJSON_Tape *tape, size_t value)
+{
+    double num;
+
+    if (!tape_valid(tape, value))
+        return 0;
+    switch (TAPE_TAG(tape->entries[value])) {
+    case TAPE_INT64:return (double) (int64_t) tape->entries[value + 1];
+    case TAPE_DOUBLE:memcpy(&num, tape->entries + value + 1, sizeof(num));
+        return num;
+    }
+    return 0;
+}
+
+int64_t
+cJSON_TapeGetInt64(const cJSON_Tape *tape, size_t value)
+{
+    if (tape_valid(tape, value) && TAPE_TAG(tape->entries[value]) == TAPE_INT64)
+        return (int64_t) tape->entries[value + 1];
+    return double_to_int64(cJSON_TapeGetNumber(tape, value));
+}
+
+/* Arrays and objects with more children than this get an index, with the
+   children in order and their count, when a lookup walks past that many.
+   Objects get a hash table of their members in the index as well. */
+#ifndef CJSON_INDEX_THRESHOLD
+#define CJSON_INDEX_THRESHOLD 16
+#endif
+
+typedef struct cJSON_Index {
+    /* the children in list order */
+    int count;
+    int capacity;
+    cJSON **items;
+
+    /* size of the table - 1, the size is a power of two */
+    unsigned int mask;
+
+    /* open addressing table of members, NULL until an object lookup */
+    cJSON **table;
+} cJSON_Index;
+
+/* FNV-1a over the case folded name, so that both case sensitive and
+   insensitive lookups land in the same chain. */
+static unsigned int
+cJSON_Hash(const char *str)
+{
+    unsigned int hash = 2166136261u;
+    while (*str)
+        hash = (hash ^ (unsigned char) tolower(*str++)) * 16777619u;
+    return hash;
+}
+
+static void
+cJSON_Drop_Table(cJSON_Index *index)
+{
+    cJSON_free(index->table);
+    index->table = 0;
+}
+
+static void
+cJSON_Drop_Index(cJSON *item)
+{
+    if (item->index) {
+        cJSON_Drop_Table(item->index);
+        cJSON_free(item->index);
+        item->index = 0;
+    }
+}
+
+/* Build the index of the count children of parent. */
+static cJSON_Index *
+cJSON_Build_Index(cJSON *parent, int count)
+{
+    cJSON_Index *index = (cJSON_Index *) cJSON_malloc(sizeof(cJSON_Index) + count * sizeof(cJSON *));
+    cJSON *c;
+    int i = 0;
+
+    if (!index)
+        return 0;
+    index->count = index->capacity = count;
+    index->items = (cJSON **) (index + 1);
+    index->mask = 0;
+    index->table = 0;
+    for (c = parent->child; c; c = c->next)
+        index->items[i++] = c;
+    parent->index = index;
+    return index;
+}
+
+static void
+cJSON_Table_Insert(cJSON_Index *index, cJSON *c)
+{
+    unsigned int slot = cJSON_Hash(c->string) & index->mask;
+    while (index->table[slot])
+        slot = (slot + 1) & index->mask;
+    index->table[slot] = c;
+}
+
+/* Build the hash table of an object. Members are inserted in list order,
+   and linear probing keeps that order within a chain, so the first match of
+   a probe is the same member the list walk would have found. */
+static int
+cJSON_Build_Table(cJSON_Index *index)
+{
+    unsigned int size = 8;
+    int i;
+
+    while (size < (unsigned int) index->count * 2)
+        size <<= 1;
+    index->table = (cJSON **) cJSON_malloc(size * sizeof(cJSON *));
+    if (!index->table)
+        return 0;
+    index->mask = size - 1;
+    memset(index->table, 0, size * sizeof(cJSON *));
+    for (i = 0; i < index->count; i++) {
+        if (index->items[i]->string)
+            cJSON_Table_Insert(index, index->items[i]);
+    }
+    return 1;
+}
+
+/* Append item to the index of parent. The index is dropped if it cannot
+   grow, the table if it gets too full. */
+static void
+cJSON_Index_Append(cJSON *parent, cJSON *item)
+{
+    cJSON_Index *index = parent->index;
+
+    if (index->count == index->capacity) {
+        int capacity = index->capacity * 2;
+        cJSON_Index *grown = (cJSON_Index *) cJSON_malloc(sizeof(cJSON_Index) + capacity * sizeof(cJSON *));
+        if (!grown) {
+            cJSON_Drop_Index(parent);
+            return;
+        }
+        memcpy(grown, index, sizeof(cJSON_Index));
+        grown->capacity = capacity;
+        grown->items = (cJSON **) (grown + 1);
+        memcpy(grown->items, index->items, index->count * sizeof(cJSON *));
+        cJSON_free(index);
+        parent->index = index = grown;
+    }
+    index->items[index->count++] = item;
+    if (index->table) {
+        if ((unsigned int) index->count * 2 > index->mask + 1)
+            cJSON_Drop_Table(index);
+        else if (item->string)
+            cJSON_Table_Insert(index, item);
+    }
+}
+
+/* Count the children of parent, and index them when there are many. */
+static int
+count_items(cJSON *parent)
+{
+    cJSON *c = parent->child;
+    int count = 0;
+
+    if (parent->index)
+        return parent->index->count;
+    while (c)
+        count++, c = c->next;
+    /* a reference shares the children of its original, which would not
+       drop the index of the reference when they change */
+    if (count > CJSON_INDEX_THRESHOLD && !(parent->type & cJSON_IsReference))
+        cJSON_Build_Index(parent, count);
+    return count;
+}
+
+/* The child at position which, without indexing the parent. */
+static cJSON *
+find_item(cJSON *parent, int which)
+{
+    cJSON *c = parent->child;
+
+    if (parent->index)
+        return which < parent->index->count ? parent->index->items[which > 0 ? which : 0] : 0;
+    while (c && which > 0)
+        which--, c = c->next;
+    return c;
+}
+
+/* Get Array size/item / object item. */
+int
+cJSON_GetArraySize(cJSON *array)
+{
+    return count_items(array);
+}
+
+cJSON *
+cJSON_GetArrayItem(cJSON *array, int item)
+{
+    cJSON *c = find_item(array, item);
+
+    if (item > CJSON_INDEX_THRESHOLD && !array->index && c)
+        count_items(array);
+    return c;
+}
+
+static cJSON *
+get_object_item(cJSON *object, const char *string, int case_sensitive)
+{
+    cJSON *c;
+    int count = 0;
+
+    if (!string)
+        return 0;
+    if (object->index && (object->index->table || (object->type == cJSON_Object &&
+                                                   cJSON_Build_Table(object->index)))) {
+        cJSON_Index *index = object->index;
+        unsigned int slot = cJSON_Hash(string) & index->mask;
+        while ((c = index->table[slot])) {
+            if (case_sensitive ? !strcmp(c->string, string) : !cJSON_strcasecmp(c->string, string))
+                return c;
+            slot = (slot + 1) & index->mask;
+        }
+        return 0;
+    }
+
+    c = object->child;
+    if (case_sensitive) {
+        while (c && (!c->string || c->string[0] != string[0] || strcmp(c->string, string)))
+            count++, c = c->next;
+    } else {
+        while (c && cJSON_strcasecmp(c->string, string))
+            count++, c = c->next;
+    }
+    if (count > CJSON_INDEX_THRESHOLD && object->type == cJSON_Object) {
+        count_items(object);
+        if (object->index)
+            cJSON_Build_Table(object->index);
+    }
+    return c;
+}
+
+cJSON *
+cJSON_GetObjectItem(cJSON *object, const char *string)
+{
+    return get_object_item(object, string, 0);
+}
+
+cJSON *
+cJSON_GetObjectItemCaseSensitive(cJSON *object, const char *string)
+{
+    return get_object_item(object, string, 1);
+}
+
+/* Steps of compiled paths. */
+#define PATH_NAME 0     /* .name, or a JSON Pointer token which is no number */
+#define PATH_INDEX 1    /* [N], or [-N] counting from the end */
+#define PATH_NAME_OR_INDEX 2 /* a numeric JSON Pointer token, its meaning
+                                depends on the container */
+
+typedef struct {
+    int kind;
+    int index;
+    unsigned int hash; /* of the name */
+    const char *name;  /* NUL-terminated, in the buffer of the path */
+} path_step;
+
+struct cJSON_Path {
+    int nsteps;
+    path_step *steps;
+    char *names;
+};
+
+/* Split a sub-document path into steps, or count them when steps is NULL.
+   Returns the number of steps, or -1 if the path is malformed. */
+static int
+path_compile_subdoc(const char *path, path_step *steps, char *names)
+{
+    int n = 0, negative;
+    path_step step;
+
+    while (*path) {
+        if (n && *path == '.' && path[1] && path[1] != '[') {
+            path++;
+        } else if (n && *path != '[') {
+            return -1;
+        }
+        step.name = names;
+        step.index = 0;
+        if (*path == '[') {
+            step.kind = PATH_INDEX;
+            negative = *++path == '-';
+            if (negative)
+                path++;
+            if (*path < '0' || *path > '9')
+                return -1;
+            while (*path >= '0' && *path <= '9') {
+                if (step.index > (INT_MAX - 9) / 10)
+                    return -1;
+                step.index = step.index * 10 + (*path++ - '0');
+            }
+            if (*path++ != ']' || (negative && !step.index))
+                return -1;
+            if (negative)
+                step.index = -step.index;
+            step.name = "";
+        } else if (*path == '`') {
+            step.kind = PATH_NAME;
+            for (path++;; path++) {
+                if (!*path)
+                    return -1;
+                if (*path == '`' && *++path != '`')
+                    break;
+                if (names)
+                    *names++ = *path;
+            }
+        } else {
+            step.kind = PATH_NAME;
+            if (*path == '.')
+                return -1; /* empty name */
+            for (; *path && *path != '.' && *path != '['; path++) {
+                if (*path == ']' || *path == '`')
+                    return -1;
+                if (names)
+                    *names++ = *path;
+            }
+        }
+        if (steps) {
+            if (step.kind == PATH_NAME)
+                *names++ = 0;
+            steps[n] = step;
+        }
+        n++;
+    }
+    return n;
+}
+
+/* Split an RFC 6901 JSON Pointer into steps, or count them when steps is
+   NULL. */
+static int
+path_compile_pointer(const char *path, path_step *steps, char *names)
+{
+    int n = 0, digits;
+    path_step step;
+
+    while (*path == '/') {
+        step.kind = PATH_NAME;
+        step.index = 0;
+        step.name = names;
+        digits = 0;
+        for (path++; *path && *path != '/'; path++) {
+            char c = *path;
+            if (c == '~') {
+                if (path[1] != '0' && path[1] != '1')
+                    return -1;
+                c = *++path == '0' ? '~' : '/';
+            }
+            if (c >= '0' && c <= '9' && digits >= 0 && digits < 9 && !(digits == 1 && step.index == 0)) {
+                step.index = step.index * 10 + (c - '0');
+                digits++;
+            } else {
+                digits = -1;
+            }
+            if (names)
+                *names++ = c;
+        }
+        if (digits > 0)
+            step.kind = PATH_NAME_OR_INDEX;
+        if (steps) {
+            *names++ = 0;
+            steps[n] = step;
+        }
+        n++;
+    }
+    return *path ? -1 : n;
+}
+
+cJSON_Path *
+cJSON_CompilePath(const char *path)
+{
+    int pointer, n, i;
+    cJSON_Path *compiled;
+
+    if (!path)
+        return 0;
+    pointer = *path == '/';
+    n = pointer ? path_compile_pointer(path, 0, 0) : path_compile_subdoc(path, 0, 0);
+    if (n < 0)
+        return 0;
+
+    /* the names take at most the length of the path, plus terminators */
+    compiled = (cJSON_Path *) cJSON_malloc(sizeof(cJSON_Path) + n * sizeof(path_step) + strlen(path) + n + 1);
+    if (!compiled)
+        return 0;
+    compiled->nsteps = n;
+    compiled->steps = (path_step *) (compiled + 1);
+    compiled->names = (char *) (compiled->steps + n);
+    if (pointer)
+        path_compile_pointer(path, compiled->steps, compiled->names);
+    else
+        path_compile_subdoc(path, compiled->steps, compiled->names);
+    for (i = 0; i < n; i++)
+        compiled->steps[i].hash = cJSON_Hash(compiled->steps[i].name);
+    return compiled;
+}
+
+void
+cJSON_DeletePath(cJSON_Path *path)
+{
+    cJSON_free(path);
+}
+
+/* The member of object named by the step, probing the hash table of the
+   object with the hash of the step when it has one. */
+static cJSON *
+path_member(cJSON *object, const path_step *step)
+{
+    cJSON_Index *index = object->index;
+    cJSON *c;
 
-    if (!parse_value(c, skip(value))) {
-        cJSON_Delete(c);
+    if (index && index->table) {
+        unsigned int slot = step->hash & index->mask;
+        while ((c = index->table[slot])) {
+            if (!strcmp(c->string, step->name))
+                return c;
+            slot = (slot + 1) & index->mask;
+        }
         return 0;
     }
-    return c;
+    return get_object_item(object, step->name, 1);
 }
 
-/* Render a cJSON item/entity/structure to text. */
-char *
-cJSON_Print(cJSON *item)
+cJSON *
+cJSON_PathGet(const cJSON_Path *path, cJSON *item)
 {
-    return print_value(item, 0, 1);
+    const path_step *step, *end;
+    int which;
+
+    if (!path)
+        return 0;
+    for (step = path->steps, end = step + path->nsteps; item && step < end; step++) {
+        switch (item->type & 0xFF) {
+        case cJSON_Object:
+            item = step->kind == PATH_INDEX ? 0 : path_member(item, step);
+            break;
+        case cJSON_Array:
+            if (step->kind == PATH_NAME)
+                return 0;
+            which = step->index;
+            if (which < 0 && (which += count_items(item)) < 0)
+                return 0;
+            item = find_item(item, which);
+            break;
+        default:
+            return 0;
+        }
+    }
+    return item;
 }
 
-char *
-cJSON_PrintUnformatted(cJSON *item)
+/* A set of paths is a tree of steps, the paths with a common beginning
+   share the steps of it. */
+typedef struct {
+    path_step step; /* from the parent node to this one */
+    int child;      /* first child, or -1 */
+    int sibling;    /* next child of the parent, or -1 */
+    int result;     /* the first path ending here, or -1 */
+
+    /* the children which take a name, from names on in the member_nodes
+       and member_first arrays of the set */
+    int names;
+    int nnames;
+} path_node;
+
+struct cJSON_PathSet {
+    int npaths;
+    path_node *nodes;
+    int *next_result; /* the next path ending at the same node, or -1 */
+
+    /* the nodes of the names looked up in the objects, and the first
+       character of each name, which rules out most members at once */
+    int *member_nodes;
+    char *member_first;
+};
+
+static int
+path_compile(const char *path, path_step *steps, char *names)
 {
-    return print_value(item, 0, 0);
+    return *path == '/' ? path_compile_pointer(path, steps, names) : path_compile_subdoc(path, steps, names);
 }
 
-/* Parser core - when encountering text, process appropriately. */
-static const char *
-parse_value(cJSON *item, const char *value)
+static int
+path_same_step(const path_step *a, const path_step *b)
 {
-    if (!value)
-        return 0; /* Fail on null. */
-    if (!strncmp(value, "null", 4)) {
-        item->type = cJSON_NULL;
-        return value + 4;
-    }
-    if (!strncmp(value, "false", 5)) {
-        item->type = cJSON_False;
-        return value + 5;
-    }
-    if (!strncmp(value, "true", 4)) {
-        item->type = cJSON_True;
-        item->valueint = 1;
-        return value + 4;
-    }
-    if (*value == '\"') {
-        return parse_string(item, value);
-    }
-    if (*value == '-' || (*value >= '0' && *value <= '9')) {
-        return parse_number(item, value);
-    }
-    if (*value == '[') {
-        return parse_array(item, value);
-    }
-    if (*value == '{') {
-        return parse_object(item, value);
-    }
-
-    return 0; /* failure. */
+    return a->kind == b->kind && a->index == b->index && !strcmp(a->name, b->name);
 }
 
-/* Render a value to text. */
-static char *
-print_value(cJSON *item, int depth, int fmt)
-{
-    char *out = 0;
-    if (!item)
-        return 0;
-    switch ((item->type) & 255) {
-    case cJSON_NULL:out = cJSON_strdup("null");
-        break;
-    case cJSON_False:out = cJSON_strdup("false");
-        break;
-    case cJSON_True:out = cJSON_strdup("true");
-        break;
-    case cJSON_Number:out = print_number(item);
-        break;
-    case cJSON_String:out = print_string(item);
-        break;
-    case cJSON_Array:out = print_array(item, depth, fmt);
-        break;
-    case cJSON_Object:out = print_object(item, depth, fmt);
-        break;
-    }
-    return out;
-}
-
-/* Build an array from input text. */
-static const char *
-parse_array(cJSON *item, const char *value)
+cJSON_PathSet *
+cJSON_CompilePathSet(const char **paths, int npaths)
 {
-    cJSON *child;
-    if (*value != '[')
-        return 0; /* not an array! */
+    int i, n, nsteps = 0, nnodes = 1, maxsteps = 0, nnames = 0;
+    size_t names_len = 0;
+    cJSON_PathSet *set;
+    path_step *steps;
+    char *names;
 
-    item->type = cJSON_Array;
-    value = skip(value + 1);
-    if (*value == ']')
-        return value + 1; /* empty array. */
-
-    item->child = child = cJSON_New_Item(item);
-    if (!item->child)
-        return 0;                                  /* memory fail */
-    value = skip(parse_value(child, skip(value))); /* skip any spacing, get the value. */
-    if (!value)
+    if (!paths || npaths <= 0)
         return 0;
-
-    while (*value == ',') {
-        cJSON *new_item;
-        if (!(new_item = cJSON_New_Item(item)))
-            return 0; /* memory fail */
-        child->next = new_item;
-        new_item->prev = child;
-        child = new_item;
-        value = skip(parse_value(child, skip(value + 1)));
-        if (!value)
-            return 0; /* memory fail */
+    for (i = 0; i < npaths; i++) {
+        if (!paths[i] || (n = path_compile(paths[i], 0, 0)) < 0)
+            return 0;
+        nsteps += n;
+        if (n > maxsteps)
+            maxsteps = n;
+        names_len += strlen(paths[i]) + n + 1;
     }
 
-    if (*value == ']')
-        return value + 1; /* end of array */
-    return 0;             /* malformed. */
-}
+    /* the nodes, room to compile one path, the result chains, the members,
+       and the names */
+    set = (cJSON_PathSet *) cJSON_malloc(sizeof(cJSON_PathSet) + (nsteps + 1) * sizeof(path_node) +
+                                         maxsteps * sizeof(path_step) + (npaths + nsteps) * sizeof(int) +
+                                         nsteps + names_len);
+    if (!set)
+        return 0;
+    set->npaths = npaths;
+    set->nodes = (path_node *) (set + 1);
+    steps = (path_step *) (set->nodes + nsteps + 1);
+    set->next_result = (int *) (steps + maxsteps);
+    set->member_nodes = set->next_result + npaths;
+    set->member_first = (char *) (set->member_nodes + nsteps);
+    names = set->member_first + nsteps;
+    memset(set->nodes, 0, sizeof(path_node));
+    set->nodes[0].child = set->nodes[0].sibling = set->nodes[0].result = -1;
 
-/* Render an array to text */
-static char *
-print_array(cJSON *item, int depth, int fmt)
-{
-    char **entries;
-    char *out = 0, *ptr, *ret;
-    size_t len = 5;
-    cJSON *child = item->child;
-    int numentries = 0, i = 0, fail = 0;
-
-    /* How many entries in the array? */
-    while (child)
-        numentries++, child = child->next;
-    /* Allocate an array to hold the values for each */
-    entries = (char **) cJSON_malloc(numentries * sizeof(char *));
-    if (!entries)
-        return 0;
-    memset(entries, 0, numentries * sizeof(char *));
-    /* Retrieve all the results: */
-    child = item->child;
-    while (child && !fail) {
-        ret = print_value(child, depth + 1, fmt);
-        entries[i++] = ret;
-        if (ret)
-            len += strlen(ret) + 2 + (fmt ? 1 : 0);
-        else
-            fail = 1;
-        child = child->next;
+    for (i = 0; i < npaths; i++) {
+        int s, node = 0, c;
+
+        n = path_compile(paths[i], steps, names);
+        for (s = 0; s < n; s++) {
+            for (c = set->nodes[node].child; c >= 0; c = set->nodes[c].sibling) {
+                if (path_same_step(&set->nodes[c].step, steps + s))
+                    break;
+            }
+            if (c < 0) {
+                c = nnodes++;
+                set->nodes[c].step = steps[s];
+                if (steps[s].kind != PATH_INDEX) {
+                    /* keep the name, the following paths compile over the rest */
+                    size_t len = strlen(steps[s].name) + 1;
+                    memmove(names, steps[s].name, len);
+                    set->nodes[c].step.name = names;
+                    set->nodes[c].step.hash = cJSON_Hash(names);
+                    names += len;
+                }
+                set->nodes[c].child = set->nodes[c].result = -1;
+                set->nodes[c].sibling = set->nodes[node].child;
+                set->nodes[node].child = c;
+            }
+            node = c;
+        }
+        set->next_result[i] = set->nodes[node].result;
+        set->nodes[node].result = i;
     }
 
-    /* If we didn't fail, try to malloc the output string */
-    if (!fail)
-        out = cJSON_malloc(len);
-    /* If that fails, we fail. */
-    if (!out)
-        fail = 1;
-
-    /* Handle failure. */
-    if (fail) {
-        for (i = 0; i < numentries; i++)
-            if (entries[i])
-                cJSON_free(entries[i]);
-        cJSON_free(entries);
-        return 0;
-    }
-
-    /* Compose the output array. */
-    *out = '[';
-    ptr = out + 1;
-    *ptr = 0;
-    for (i = 0; i < numentries; i++) {
-        strcpy(ptr, entries[i]);
-        ptr += strlen(entries[i]);
-        if (i != numentries - 1) {
-            *ptr++ = ',';
-            if (fmt)
-                *ptr++ = ' ';
-            *ptr = 0;
+    for (i = 0; i < nnodes; i++) {
+        int c;
+
+        set->nodes[i].names = nnames;
+        for (c = set->nodes[i].child; c >= 0; c = set->nodes[c].sibling) {
+            if (set->nodes[c].step.kind != PATH_INDEX) {
+                set->member_nodes[nnames] = c;
+                set->member_first[nnames++] = set->nodes[c].step.name[0];
+            }
         }
-        cJSON_free(entries[i]);
+        set->nodes[i].nnames = nnames - set->nodes[i].names;
     }
-    cJSON_free(entries);
-    *ptr++ = ']';
-    *ptr++ = 0;
-    return out;
+    return set;
 }
 
-/* Build an object from the text. */
-static const char *
-parse_object(cJSON *item, const char *value)
+void
+cJSON_DeletePathSet(cJSON_PathSet *set)
 {
-    cJSON *child;
-    if (*value != '{')
-        return 0; /* not an object! */
-
-    item->type = cJSON_Object;
-    value = skip(value + 1);
-    if (*value == '}')
-        return value + 1; /* empty array. */
-
-    item->child = child = cJSON_New_Item(item);
-    value = skip(parse_string(child, skip(value)));
-    if (!value)
-        return 0;
-    child->string = child->valuestring;
-    child->valuestring = 0;
-    if (*value != ':')
-        return 0;                                      /* fail! */
-    value = skip(parse_value(child, skip(value + 1))); /* skip any spacing, get the value. */
-    if (!value)
-        return 0;
+    cJSON_free(set);
+}
 
-    while (*value == ',') {
-        cJSON *new_item;
-        if (!(new_item = cJSON_New_Item(item)))
-            return 0; /* memory fail */
-        child->next = new_item;
-        new_item->prev = child;
-        child = new_item;
-        value = skip(parse_string(child, skip(value + 1)));
-        if (!value)
-            return 0;
-        child->string = child->valuestring;
-        child->valuestring = 0;
-        if (*value != ':')
-            return 0;                                      /* fail! */
-        value = skip(parse_value(child, skip(value + 1))); /* skip any spacing, get the value. */
-        if (!value)
-            return 0;
-    }
+static int
+path_set_visit(const cJSON_PathSet *set, int node, cJSON *item, cJSON **values);
 
-    if (*value == '}')
-        return value + 1; /* end of array */
-    return 0;             /* malformed. */
-}
+/* Find the members of object named by the children of node. Small objects
+   are walked once for all of them. */
+static int
+path_set_members(const cJSON_PathSet *set, int node, cJSON *object, cJSON **values)
+{
+    const path_node *nodes = set->nodes;
+    const int *wanted = set->member_nodes + nodes[node].names;
+    const char *first = set->member_first + nodes[node].names;
+    int k, n = nodes[node].nnames, found = 0;
+    unsigned long long pending;
+    cJSON *m;
 
-/* Render an object to text. */
-static char *
-print_object(cJSON *item, int depth, int fmt)
-{
-    char **entries = 0, **names = 0;
-    char *out = 0, *ptr, *ret, *str;
-    size_t len = 7;
-    int i = 0, j;
-    cJSON *child = item->child;
-    int numentries = 0, fail = 0;
-    /* Count the number of entries. */
-    while (child)
-        numentries++, child = child->next;
-    /* Allocate space for the names and the objects */
-    entries = (char **) cJSON_malloc(numentries * sizeof(char *));
-    if (!entries)
-        return 0;
-    names = (char **) cJSON_malloc(numentries * sizeof(char *));
-    if (!names) {
-        cJSON_free(entries);
-        return 0;
-    }
-    memset(entries, 0, sizeof(char *) * numentries);
-    memset(names, 0, sizeof(char *) * numentries);
-
-    /* Collect all the results into our arrays: */
-    child = item->child;
-    depth++;
-    if (fmt)
-        len += depth;
-    while (child) {
-        names[i] = str = print_string_ptr(child->string);
-        entries[i++] = ret = print_value(child, depth, fmt);
-        if (str && ret)
-            len += strlen(ret) + strlen(str) + 2 + (fmt ? 2 + depth : 0);
-        else
-            fail = 1;
-        child = child->next;
+    if (n > 64 || (object->index && object->index->table)) {
+        /* too many names to track, or a table to look them up in */
+        for (k = 0; k < n; k++) {
+            if ((m = path_member(object, &nodes[wanted[k]].step)))
+                found += path_set_visit(set, wanted[k], m, values);
+        }
+        return found;
     }
-
-    /* Try to allocate the output string */
-    if (!fail)
-        out = (char *) cJSON_malloc(len);
-    if (!out)
-        fail = 1;
-
-    /* Handle failure */
-    if (fail) {
-        for (i = 0; i < numentries; i++) {
-            if (names[i])
-                free(names[i]);
-            if (entries[i])
-                free(entries[i]);
+    pending = n == 64 ? ~0ULL : (1ULL << n) - 1;
+    for (m = object->child; m && pending; m = m->next) {
+        if (!m->string)
+            continue;
+        for (k = 0; k < n; k++) {
+            if (first[k] == m->string[0] && (pending & (1ULL << k)) &&
+                !strcmp(m->string, nodes[wanted[k]].step.name)) {
+                pending &= ~(1ULL << k);
+                found += path_set_visit(set, wanted[k], m, values);
+            }
         }
-        free(names);
-        free(entries);
-        return 0;
-    }
-
-    /* Compose the output: */
-    *out = '{';
-    ptr = out + 1;
-    if (fmt)
-        *ptr++ = '\n';
-    *ptr = 0;
-    for (i = 0; i < numentries; i++) {
-        if (fmt)
-            for (j = 0; j < depth; j++)
-                *ptr++ = '\t';
-        strcpy(ptr, names[i]);
-        ptr += strlen(names[i]);
-        *ptr++ = ':';
-        if (fmt)
-            *ptr++ = '\t';
-        strcpy(ptr, entries[i]);
-        ptr += strlen(entries[i]);
-        if (i != numentries - 1)
-            *ptr++ = ',';
-        if (fmt)
-            *ptr++ = '\n';
-        *ptr = 0;
-        cJSON_free(names[i]);
-        cJSON_free(entries[i]);
-    }
-
-    cJSON_free(names);
-    cJSON_free(entries);
-    if (fmt)
-        for (i = 0; i < depth - 1; i++)
-            *ptr++ = '\t';
-    *ptr++ = '}';
-    *ptr++ = 0;
-    return out;
+    }
+    return found;
 }
 
-/* Get Array size/item / object item. */
-int
-cJSON_GetArraySize(cJSON *array)
+static int
+path_set_visit(const cJSON_PathSet *set, int node, cJSON *item, cJSON **values)
 {
-    cJSON *c = array->child;
-    int i = 0;
-    while (c)
-        i++, c = c->next;
-    return i;
-}
+    const path_node *nodes = set->nodes;
+    int r, c, which, found = 0;
+    cJSON *e;
 
-cJSON *
-cJSON_GetArrayItem(cJSON *array, int item)
-{
-    cJSON *c = array->child;
-    while (c && item > 0)
-        item--, c = c->next;
-    return c;
+    for (r = nodes[node].result; r >= 0; r = set->next_result[r]) {
+        values[r] = item;
+        found++;
+    }
+    if (nodes[node].child < 0)
+        return found;
+    switch (item->type & 0xFF) {
+    case cJSON_Object:
+        return found + path_set_members(set, node, item, values);
+    case cJSON_Array:
+        for (c = nodes[node].child; c >= 0; c = nodes[c].sibling) {
+            if (nodes[c].step.kind == PATH_NAME)
+                continue;
+            which = nodes[c].step.index;
+            if (which < 0 && (which += count_items(item)) < 0)
+                continue;
+            if ((e = find_item(item, which)))
+                found += path_set_visit(set, c, e, values);
+        }
+    }
+    return found;
 }
 
-cJSON *
-cJSON_GetObjectItem(cJSON *object, const char *string)
+int
+cJSON_PathSetGet(const cJSON_PathSet *set, cJSON *item, cJSON **values)
 {
-    cJSON *c = object->child;
-    while (c && cJSON_strcasecmp(c->string, string))
-        c = c->next;
-    return c;
+    if (!set || !values)
+        return 0;
+    memset(values, 0, set->npaths * sizeof(cJSON *));
+    return item ? path_set_visit(set, 0, item, values) : 0;
 }
 
 /* Utility for array list handling. */
@@ -847,6 +3893,7 @@ create_reference(cJSON *item)
     cJSON *ref = cJSON_New_Item(item);
     memcpy(ref, item, sizeof(cJSON));
     ref->string = 0;
+    ref->index = 0;
     ref->type |= cJSON_IsReference;
     ref->next = ref->prev = 0;
     return ref;
@@ -857,21 +3904,29 @@ void
 cJSON_AddItemToArray(cJSON *array, cJSON *item)
 {
     cJSON *c = array->child;
-    if (!c) {
+    int count = 1;
+
+    if (array->index) {
+        suffix_object(array->index->items[array->index->count - 1], item);
+        cJSON_Index_Append(array, item);
+    } else if (!c) {
         array->child = item;
     } else {
-        while (c && c->next)
-            c = c->next;
+        while (c->next)
+            count++, c = c->next;
         suffix_object(c, item);
+        if (count >= CJSON_INDEX_THRESHOLD && !(array->type & cJSON_IsReference))
+            cJSON_Build_Index(array, count + 1);
     }
 }
 
 void
 cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item)
 {
-    if (item->string)
+    if (item->string && !(item->flags & CJSON_STRING_BORROWED))
         cJSON_free(item->string);
     item->string = cJSON_strdup(string);
+    item->flags &= ~CJSON_STRING_BORROWED;
     cJSON_AddItemToArray(object, item);
 }
 
@@ -887,24 +3942,46 @@ cJSON_AddItemReferenceToObject(cJSON *object, const char *string, cJSON *item)
     cJSON_AddItemToObject(object, string, create_reference(item));
 }
 
-cJSON *
-cJSON_DetachItemFromArray(cJSON *array, int which)
+/* Unlink the child from its parent. */
+static cJSON *
+detach_item(cJSON *parent, cJSON *c)
 {
-    cJSON *c = array->child;
-    while (c && which > 0)
-        c = c->next, which--;
     if (!c)
         return 0;
+    cJSON_Drop_Index(parent);
     if (c->prev)
         c->prev->next = c->next;
     if (c->next)
         c->next->prev = c->prev;
-    if (c == array->child)
-        array->child = c->next;
+    if (c == parent->child)
+        parent->child = c->next;
     c->prev = c->next = 0;
     return c;
 }
 
+/* Put newitem into the place of c, and delete c. */
+static void
+replace_item(cJSON *parent, cJSON *c, cJSON *newitem)
+{
+    cJSON_Drop_Index(parent);
+    newitem->next = c->next;
+    newitem->prev = c->prev;
+    if (newitem->next)
+        newitem->next->prev = newitem;
+    if (c == parent->child)
+        parent->child = newitem;
+    else
+        newitem->prev->next = newitem;
+    c->next = c->prev = 0;
+    cJSON_Delete(c);
+}
+
+cJSON *
+cJSON_DetachItemFromArray(cJSON *array, int which)
+{
+    return detach_item(array, find_item(array, which));
+}
+
 void
 cJSON_DeleteItemFromArray(cJSON *array, int which)
 {
@@ -914,13 +3991,7 @@ cJSON_DeleteItemFromArray(cJSON *array, int which)
 cJSON *
 cJSON_DetachItemFromObject(cJSON *object, const char *string)
 {
-    int i = 0;
-    cJSON *c = object->child;
-    while (c && cJSON_strcasecmp(c->string, string))
-        i++, c = c->next;
-    if (c)
-        return cJSON_DetachItemFromArray(object, i);
-    return 0;
+    return detach_item(object, cJSON_GetObjectItem(object, string));
 }
 
 void
@@ -933,33 +4004,21 @@ cJSON_DeleteItemFromObject(cJSON *object, const char *string)
 void
 cJSON_ReplaceItemInArray(cJSON *array, int which, cJSON *newitem)
 {
-    cJSON *c = array->child;
-    while (c && which > 0)
-        c = c->next, which--;
-    if (!c)
-        return;
-    newitem->next = c->next;
-    newitem->prev = c->prev;
-    if (newitem->next)
-        newitem->next->prev = newitem;
-    if (c == array->child)
-        array->child = newitem;
-    else
-        newitem->prev->next = newitem;
-    c->next = c->prev = 0;
-    cJSON_Delete(c);
+    cJSON *c = find_item(array, which);
+    if (c)
+        replace_item(array, c, newitem);
 }
 
 void
 cJSON_ReplaceItemInObject(cJSON *object, const char *string, cJSON *newitem)
 {
-    int i = 0;
-    cJSON *c = object->child;
-    while (c && cJSON_strcasecmp(c->string, string))
-        i++, c = c->next;
+    cJSON *c = cJSON_GetObjectItem(object, string);
     if (c) {
+        if (newitem->string && !(newitem->flags & CJSON_STRING_BORROWED))
+            cJSON_free(newitem->string);
         newitem->string = cJSON_strdup(string);
-        cJSON_ReplaceItemInArray(object, i, newitem);
+        newitem->flags &= ~CJSON_STRING_BORROWED;
+        replace_item(object, c, newitem);
     }
 }
 
@@ -993,8 +4052,16 @@ cJSON_CreateNumber(double num)
 {
     cJSON *item = cJSON_New_Item(0);
     item->type = cJSON_Number;
-    item->valuedouble = num;
-    item->valueint = (int) num;
+    set_number(item, num);
+    return item;
+}
+
+cJSON *
+cJSON_CreateInt64(int64_t num)
+{
+    cJSON *item = cJSON_New_Item(0);
+    item->type = cJSON_Number;
+    set_int64(item, num);
     return item;
 }
 
@@ -1030,7 +4097,7 @@ cJSON_CreateIntArray(int *numbers, int count)
     int i;
     cJSON *n = 0, *p = 0, *a = cJSON_CreateArray();
     for (i = 0; i < count; i++) {
-        n = cJSON_CreateNumber(numbers[i]);
+        n = cJSON_CreateInt64(numbers[i]);
         if (!i)
             a->child = n;
         else
@@ -1087,3 +4154,282 @@ cJSON_CreateStringArray(const char **strings, int count)
     }
     return a;
 }
+
+/* Copy an item with everything below it, the name included. */
+static cJSON *
+duplicate_item(const cJSON *item, int depth)
+{
+    cJSON *copy, *child, *tail = 0;
+    const cJSON *c;
+
+    if (depth > recursion_limit() || !(copy = cJSON_New_Item(0)))
+        return 0;
+    copy->type = item->type & ~cJSON_IsReference;
+    copy->flags = item->flags & CJSON_NUMBER_INT64;
+    copy->valueint = item->valueint;
+    copy->valuedouble = item->valuedouble;
+    copy->valueint64 = item->valueint64;
+    if ((item->valuestring && !(copy->valuestring = cJSON_strdup(item->valuestring))) ||
+        (item->string && !(copy->string = cJSON_strdup(item->string)))) {
+        cJSON_Delete(copy);
+        return 0;
+    }
+    for (c = item->child; c; c = c->next) {
+        if (!(child = duplicate_item(c, depth + 1))) {
+            cJSON_Delete(copy);
+            return 0;
+        }
+        if (tail)
+            suffix_object(tail, child);
+        else
+            copy->child = child;
+        tail = child;
+    }
+    return copy;
+}
+
+/* Names in diff paths are escaped like in sub-document paths. */
+static int
+diff_needs_quotes(const char *name)
+{
+    for (; *name; name++) {
+        if (*name == '.' || *name == '[' || *name == ']' || *name == '`')
+            return 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    cJSON_DiffCallback callback;
+    void *ctx;
+    sax_scratch path;
+    size_t len;
+    int depth;
+} diff_state;
+
+static int
+diff_emit(diff_state *d, int op, const cJSON *value)
+{
+    if (!sax_reserve(&d->path, d->len + 1))
+        return 0;
+    d->path.buf[d->len] = 0;
+    return d->callback(d->ctx, op, d->path.buf, value);
+}
+
+static int
+diff_push_name(diff_state *d, const char *name)
+{
+    size_t len = strlen(name), quotes = diff_needs_quotes(name);
+    const char *c;
+    char *out;
+
+    /* every character may be a doubled backtick, plus the dot and quotes */
+    if (!sax_reserve(&d->path, d->len + (quotes ? 2 * len + 3 : len + 1) + 1))
+        return 0;
+    out = d->path.buf + d->len;
+    if (d->len)
+        *out++ = '.';
+    if (quotes) {
+        *out++ = '`';
+        for (c = name; *c; c++) {
+            if (*c == '`')
+                *out++ = '`';
+            *out++ = *c;
+        }
+        *out++ = '`';
+    } else {
+        memcpy(out, name, len);
+        out += len;
+    }
+    d->len = out - d->path.buf;
+    return 1;
+}
+
+static int
+diff_push_index(diff_state *d, int index)
+{
+    if (!sax_reserve(&d->path, d->len + 16))
+        return 0;
+    d->len += sprintf(d->path.buf + d->len, "[%d]", index);
+    return 1;
+}
+
+static int
+diff_items(diff_state *d, const cJSON *from, const cJSON *to);
+
+static int
+diff_arrays(diff_state *d, const cJSON *from, const cJSON *to)
+{
+    size_t len = d->len;
+    const cJSON *f = from->child, *t = to->child;
+    int i, count;
+
+    for (i = 0; f && t; i++, f = f->next, t = t->next) {
+        if (!diff_push_index(d, i) || !diff_items(d, f, t))
+            return 0;
+        d->len = len;
+    }
+    for (; t; t = t->next) {
+        if (!diff_emit(d, CJSON_DIFF_APPEND, t))
+            return 0;
+    }
+    if (f) {
+        /* remove from the end, so that the positions of the others hold */
+        for (count = i; f; f = f->next)
+            count++;
+        while (count-- > i) {
+            if (!diff_push_index(d, count) || !diff_emit(d, CJSON_DIFF_REMOVE, 0))
+                return 0;
+            d->len = len;
+        }
+    }
+    return 1;
+}
+
+static int
+diff_objects(diff_state *d, const cJSON *from, const cJSON *to)
+{
+    size_t len = d->len;
+    const cJSON *f, *t;
+
+    for (f = from->child; f; f = f->next) {
+        if (!f->string)
+            continue;
+        t = cJSON_GetObjectItemCaseSensitive((cJSON *) to, f->string);
+        if (!diff_push_name(d, f->string) ||
+            !(t ? diff_items(d, f, t) : diff_emit(d, CJSON_DIFF_REMOVE, 0)))
+            return 0;
+        d->len = len;
+    }
+    for (t = to->child; t; t = t->next) {
+        if (!t->string || cJSON_GetObjectItemCaseSensitive((cJSON *) from, t->string))
+            continue;
+        if (!diff_push_name(d, t->string) || !diff_emit(d, CJSON_DIFF_SET, t))
+            return 0;
+        d->len = len;
+    }
+    return 1;
+}
+
+static int
+diff_items(diff_state *d, const cJSON *from, const cJSON *to)
+{
+    int type = from->type & 0xFF, ok;
+
+    if (type != (to->type & 0xFF))
+        return diff_emit(d, CJSON_DIFF_SET, to);
+    switch (type) {
+    case cJSON_Number:
+        if ((from->flags & to->flags & CJSON_NUMBER_INT64) ? from->valueint64 == to->valueint64
+                                                           : from->valuedouble == to->valuedouble)
+            return 1;
+        return diff_emit(d, CJSON_DIFF_SET, to);
+    case cJSON_String:
+        if (from->valuestring && to->valuestring && !strcmp(from->valuestring, to->valuestring))
+            return 1;
+        return diff_emit(d, CJSON_DIFF_SET, to);
+    case cJSON_Array:
+    case cJSON_Object:
+        if (++d->depth > recursion_limit())
+            return 0;
+        ok = type == cJSON_Array ? diff_arrays(d, from, to) : diff_objects(d, from, to);
+        d->depth--;
+        return ok;
+    }
+    return 1;
+}
+
+int
+cJSON_Diff(const cJSON *from, const cJSON *to, cJSON_DiffCallback callback, void *ctx)
+{
+    diff_state d;
+    int ok;
+
+    if (!from || !to || !callback)
+        return 0;
+    d.callback = callback;
+    d.ctx = ctx;
+    d.path.buf = 0;
+    d.path.size = 0;
+    d.len = 0;
+    d.depth = 0;
+    ok = diff_items(&d, from, to);
+    cJSON_free(d.path.buf);
+    return ok;
+}
+
+/* Make value the member name of object, in the place of old if there is one. */
+static int
+merge_set_member(cJSON *object, cJSON *old, const char *name, cJSON *value)
+{
+    if (value->string && !(value->flags & CJSON_STRING_BORROWED))
+        cJSON_free(value->string);
+    value->flags &= ~CJSON_STRING_BORROWED;
+    if (!(value->string = cJSON_strdup(name))) {
+        cJSON_Delete(value);
+        return 0;
+    }
+    if (old) {
+        replace_item(object, old, value);
+    } else {
+        /* the name is already in place, append like cJSON_AddItemToObject */
+        cJSON_AddItemToArray(object, value);
+    }
+    return 1;
+}
+
+static cJSON *
+merge_patch(cJSON *target, const cJSON *patch, int depth)
+{
+    const cJSON *p;
+    cJSON *old, *value, *replaced = 0;
+    int created = 0;
+
+    if (depth > recursion_limit())
+        return 0;
+    if ((patch->type & 0xFF) != cJSON_Object) {
+        if (!(value = duplicate_item(patch, depth)))
+            return 0;
+        cJSON_Delete(target);
+        return value;
+    }
+    if (!target || (target->type & 0xFF) != cJSON_Object) {
+        /* the replacement is built first, target is only deleted once it is complete */
+        if (!(value = cJSON_New_Item(0)))
+            return 0;
+        value->type = cJSON_Object;
+        replaced = target;
+        target = value;
+        created = 1;
+    }
+    for (p = patch->child; p; p = p->next) {
+        if (!p->string)
+            continue;
+        old = cJSON_GetObjectItemCaseSensitive(target, p->string);
+        if ((p->type & 0xFF) == cJSON_NULL) {
+            if (old)
+                cJSON_Delete(detach_item(target, old));
+        } else if (old && (old->type & 0xFF) == cJSON_Object && (p->type & 0xFF) == cJSON_Object) {
+            if (!merge_patch(old, p, depth + 1))
+                goto fail;
+        } else if (!(value = merge_patch(0, p, depth + 1)) || !merge_set_member(target, old, p->string, value)) {
+            goto fail;
+        }
+    }
+    cJSON_Delete(replaced);
+    return target;
+
+fail:
+    /* an object built here is dropped, and the target of the caller left as it was */
+    if (created)
+        cJSON_Delete(target);
+    return 0;
+}
+
+cJSON *
+cJSON_MergePatch(cJSON *target, const cJSON *patch)
+{
+    if (!patch)
+        return target;
+    return merge_patch(target, patch, 0);
+}
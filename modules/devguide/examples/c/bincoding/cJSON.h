@@ -23,6 +23,9 @@
 #ifndef cJSON__h
 #define cJSON__h
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -42,6 +45,9 @@ extern "C"
 typedef struct cJSON_PoolBlock {
     struct cJSON_PoolBlock *next;
 
+    /* the number of items in an item block, or bytes in a string chunk */
+    size_t size;
+
     /* Not visible here, however the allocation system
         will allocate this structure along with all the
         elements at once, where the elements will follow
@@ -57,6 +63,26 @@ typedef struct cJSON_Pool {
 
     /* linked list of available cJSON allocations */
     struct cJSON *free_items;
+
+    /* linked list of string chunks, the strings of parsed values and
+        names are bump allocated from the head chunk */
+    cJSON_PoolBlock *strings;
+
+    /* the unused tail of the head string chunk */
+    char *strings_next;
+    size_t strings_avail;
+
+    /* the number of items in the next block */
+    unsigned int alloc_size;
+
+    /* the size of the next string chunk */
+    size_t string_size;
+
+    /* the memory held by the blocks and the chunks */
+    size_t bytes;
+
+    /* linked list of the pools in the cache of a thread */
+    struct cJSON_Pool *next_cached;
 } cJSON_Pool;
 
 /* The cJSON structure: */
@@ -70,16 +96,22 @@ typedef struct cJSON {
                                 the items in the array/object. */
 
     int type; /* The type of the item, as above. */
+    int flags; /* Private flags, ownership of the strings and exactness of valueint64. */
 
     char *valuestring; /* The item's string, if type==cJSON_String */
     int valueint; /* The item's number, if type==cJSON_Number */
     double valuedouble; /* The item's number, if type==cJSON_Number */
+    int64_t valueint64; /* The item's number, exact for integers which fit
+                           into 64 bits, if type==cJSON_Number */
 
     char *string; /* The item's name string, if this item is the
                          child of, or is in the list of subitems of an
                          object. */
 
     struct cJSON_Pool *alloc_pool;
+
+    struct cJSON_Index *index; /* Private lookup index of an array or
+                                  object, built lazily on lookup. */
 } cJSON;
 
 typedef struct cJSON_Hooks {
@@ -95,9 +127,101 @@ extern void
 cJSON_InitHooks(cJSON_Hooks *hooks);
 
 /* Supply a block of JSON, and this returns a cJSON object you can
-   interrogate. Call cJSON_Delete when finished. */
+   interrogate. Call cJSON_Delete when finished. The strings of the parsed
+   items are owned by the tree: do not free or keep them past
+   cJSON_Delete, copy them instead. */
 extern cJSON *
 cJSON_Parse(const char *value);
+/* Same as cJSON_Parse, but reads at most len bytes of value, which does
+   not have to be NUL-terminated. */
+extern cJSON *
+cJSON_ParseWithLength(const char *value, size_t len);
+/* When return_parse_end is not NULL, it receives the position right after
+   the parsed value. With require_complete set, anything but whitespace
+   after the value makes the parse fail. */
+extern cJSON *
+cJSON_ParseWithLengthOpts(const char *value, size_t len, const char **return_parse_end, int require_complete);
+/* Parse len bytes of JSON in place. The strings of the tree are decoded
+   into buf itself and point into it, so nothing is copied, but buf is
+   modified and must outlive the tree. No terminator is needed after the
+   text. Call cJSON_Delete when finished. */
+extern cJSON *
+cJSON_ParseInPlace(char *buf, size_t len);
+/* Newline-delimited JSON, one document per line. The reader takes a file
+   descriptor, which it reads through a buffer that only grows for a line
+   longer than it, or a region of memory such as a mapped file, so files of
+   any size are read in constant memory. All documents are parsed into the
+   same pool. */
+typedef struct cJSON_NDJSONReader cJSON_NDJSONReader;
+
+extern cJSON_NDJSONReader *
+cJSON_NDJSONReaderFromFd(int fd);
+/* data has to stay valid and unchanged until cJSON_NDJSONReaderFree. */
+extern cJSON_NDJSONReader *
+cJSON_NDJSONReaderFromMemory(const char *data, size_t len);
+/* Returns the document of the next non-blank line, or NULL at the end of
+   the input or on error. The document belongs to the reader and is deleted
+   by the next call, items detached from it stay valid until deleted. After
+   a line which does not parse, cJSON_NDJSONReaderFailed is set until the
+   next call, which moves on to the line after it. */
+extern cJSON *
+cJSON_NDJSONRead(cJSON_NDJSONReader *reader);
+/* Returns 1 if the last cJSON_NDJSONRead failed, 0 if it reached the end. */
+extern int
+cJSON_NDJSONReaderFailed(const cJSON_NDJSONReader *reader);
+/* The number of the line of the last document, counting from 1. */
+extern size_t
+cJSON_NDJSONReaderLine(const cJSON_NDJSONReader *reader);
+/* Frees the reader and its last document, the file is not closed. */
+extern void
+cJSON_NDJSONReaderFree(cJSON_NDJSONReader *reader);
+
+/* The writer prints the documents unformatted into its buffer, and hands
+   the buffer to the sink when it holds buffer_size bytes, so it allocates
+   nothing per document. The sink returns 0 on failure, which makes all
+   further writes fail. */
+typedef int (*cJSON_NDJSONSink)(void *ctx, const char *data, size_t len);
+typedef struct cJSON_NDJSONWriter cJSON_NDJSONWriter;
+
+/* buffer_size of 0 picks the default of 64 KiB. */
+extern cJSON_NDJSONWriter *
+cJSON_NDJSONWriterNew(cJSON_NDJSONSink sink, void *ctx, size_t buffer_size);
+extern cJSON_NDJSONWriter *
+cJSON_NDJSONWriterFromFd(int fd, size_t buffer_size);
+/* Append item and a newline. Returns 0 on failure. */
+extern int
+cJSON_NDJSONWrite(cJSON_NDJSONWriter *writer, cJSON *item);
+/* Hand what is buffered to the sink. Returns 0 on failure. */
+extern int
+cJSON_NDJSONWriterFlush(cJSON_NDJSONWriter *writer);
+/* Flush and free the writer, the file is not closed. Returns 0 if the
+   final flush or any write before failed. */
+extern int
+cJSON_NDJSONWriterFree(cJSON_NDJSONWriter *writer);
+
+/* Set the number of items in the allocation blocks of the pools of parsed
+   trees, CJSON_POOL_ALLOC_SIZE (1024) by default, which items <= 0
+   restores. The first block of a pool is made smaller for short input. */
+extern void
+cJSON_SetPoolAllocSize(int items);
+/* Keep up to max_bytes of the pools of the trees deleted on the calling
+   thread, for the next parses on that thread to reuse instead of
+   allocating. The cache is off by default; 0 turns it off and releases
+   the pools. Call cJSON_FreePoolCache before the thread exits. */
+extern void
+cJSON_SetPoolCacheLimit(size_t max_bytes);
+extern void
+cJSON_FreePoolCache(void);
+/* Limit the nesting of arrays and objects for the parsers and the printer,
+   which fail on deeper documents. They keep the open arrays and objects on
+   the heap, so the limit bounds their memory rather than the native stack.
+   The default is CJSON_NESTING_LIMIT (1000), which limit <= 0 restores.
+   cJSON_Diff and cJSON_MergePatch recurse on the native stack instead, and
+   stop at CJSON_RECURSION_LIMIT (1000) levels whatever the limit is.
+   Like cJSON_InitHooks, call it before parsing. */
+extern void
+cJSON_SetNestingLimit(int limit);
+
 /* Render a cJSON entity to text for transfer/storage. Free the char*
    when finished. */
 extern char *
@@ -106,10 +230,122 @@ cJSON_Print(cJSON *item);
    formatting. Free the char* when finished. */
 extern char *
 cJSON_PrintUnformatted(cJSON *item);
+/* Render a cJSON entity to text using a buffered strategy. prebuffer is a
+   guess at the final size; guessing well reduces reallocation. fmt=0 gives
+   unformatted, =1 gives formatted. Free the char* when finished. */
+extern char *
+cJSON_PrintBuffered(cJSON *item, int prebuffer, int fmt);
+/* Render a cJSON entity to text into a buffer supplied by the caller.
+   Nothing is allocated. Returns 1 on success and 0 on failure, including
+   when the rendered text (with its terminator) does not fit into length
+   bytes. */
+extern int
+cJSON_PrintPreallocated(cJSON *item, char *buffer, int length, int fmt);
 /* Delete a cJSON entity and all subentities. */
 extern void
 cJSON_Delete(cJSON *c);
 
+/* Event-driven parsing. The parser calls the handler for every token of
+   the document and builds no tree. The strings given to string and key are
+   not NUL-terminated, and are only valid during the call. number gets the
+   text of the number along with its value. Every callback may be NULL, and
+   returning 0 from a callback stops the parse. */
+typedef struct cJSON_SAXHandler {
+    int (*start_object)(void *ctx);
+    int (*end_object)(void *ctx);
+    int (*start_array)(void *ctx);
+    int (*end_array)(void *ctx);
+    int (*key)(void *ctx, const char *str, size_t len);
+    int (*string)(void *ctx, const char *str, size_t len);
+    int (*number)(void *ctx, double value, const char *str, size_t len);
+    int (*boolean)(void *ctx, int value);
+    int (*null)(void *ctx);
+    /* When set, called instead of number for integers which fit into 64
+       bits, with their exact value. */
+    int (*integer)(void *ctx, int64_t value);
+} cJSON_SAXHandler;
+
+/* Parse len bytes of JSON calling the handler. Returns 1 on success, and 0
+   when the text is malformed or a callback stopped the parse. */
+extern int
+cJSON_ParseSAX(const char *value, size_t len, const cJSON_SAXHandler *handler, void *ctx);
+
+/* Receives the scalar value found at paths[path]. element is the position in
+   the innermost array on the way to the value, or -1. value and its strings
+   are only valid during the call. Return 0 to stop. */
+typedef int (*cJSON_FilterCallback)(void *ctx, int path, int element, const cJSON *value);
+
+/* Extract the scalar values at the given paths without building a tree. A
+   path is a list of member names separated with dots, "[]" matches every
+   element of an array and "[N]" the element N, e.g. "errors[].code".
+   Values at other paths, and containers, are skipped. Returns 1 on
+   success, 0 when the text or a path is malformed or the callback stopped
+   the parse. */
+extern int
+cJSON_Filter(const char *value, size_t len, const char **paths, int npaths, cJSON_FilterCallback callback,
+             void *ctx);
+
+/* Read-only compact representation of a parsed document. The values are
+   entries of one contiguous tape, with the strings in a separate arena,
+   which takes a fraction of the memory of a cJSON tree and reads with
+   fewer cache misses. Values are identified by their index in the tape,
+   the root value is at index 0, and CJSON_TAPE_NONE stands for no value.
+   Skipping over an array or object, and counting its elements, take
+   constant time. */
+typedef struct cJSON_Tape cJSON_Tape;
+
+#define CJSON_TAPE_NONE ((size_t) -1)
+
+/* Parse len bytes of JSON into a tape. Call cJSON_DeleteTape when finished. */
+extern cJSON_Tape *
+cJSON_ParseTape(const char *value, size_t len);
+extern void
+cJSON_DeleteTape(cJSON_Tape *tape);
+
+/* The cJSON type of the value, or -1 when there is no such value. */
+extern int
+cJSON_TapeType(const cJSON_Tape *tape, size_t value);
+/* The first element of an array or object, and the element following value
+   in its array or object. Walk all elements with
+       for (v = cJSON_TapeChild(t, c); v != CJSON_TAPE_NONE; v = cJSON_TapeNext(t, v)) */
+extern size_t
+cJSON_TapeChild(const cJSON_Tape *tape, size_t value);
+extern size_t
+cJSON_TapeNext(const cJSON_Tape *tape, size_t value);
+/* The counterparts of cJSON_GetArraySize, cJSON_GetArrayItem,
+   cJSON_GetObjectItem and cJSON_GetObjectItemCaseSensitive. */
+extern int
+cJSON_TapeGetArraySize(const cJSON_Tape *tape, size_t value);
+extern size_t
+cJSON_TapeGetArrayItem(const cJSON_Tape *tape, size_t array, int which);
+extern size_t
+cJSON_TapeGetObjectItem(const cJSON_Tape *tape, size_t object, const char *name);
+extern size_t
+cJSON_TapeGetObjectItemCaseSensitive(const cJSON_Tape *tape, size_t object, const char *name);
+/* The name of a member of an object, as returned by cJSON_TapeChild,
+   cJSON_TapeNext or cJSON_TapeGetObjectItem on the object. */
+extern const char *
+cJSON_TapeGetName(const cJSON_Tape *tape, size_t member);
+/* The NUL-terminated string of the value, with its length in *len when not
+   NULL. Returns NULL if the value is not a string. The strings live as long
+   as the tape. */
+extern const char *
+cJSON_TapeGetString(const cJSON_Tape *tape, size_t value, size_t *len);
+/* The number of the value, or 0 if it is not a number. Integers which fit
+   into 64 bits are exact with cJSON_TapeGetInt64. */
+extern double
+cJSON_TapeGetNumber(const cJSON_Tape *tape, size_t value);
+extern int64_t
+cJSON_TapeGetInt64(const cJSON_Tape *tape, size_t value);
+
+/* Arrays and objects with more than CJSON_INDEX_THRESHOLD children get an
+   index on the first lookup or count which walks past that many, or when
+   cJSON_AddItemToArray/Object appends to that many. The index keeps the
+   count and the children in order, and for objects a hash table of the
+   names, so the calls below take constant time. Appending keeps it up to
+   date, the Detach/Delete/Replace calls below drop it. Do not relink the
+   children of an indexed array or object by hand. */
+
 /* Returns the number of items in an array (or object). */
 extern int
 cJSON_GetArraySize(cJSON *array);
@@ -120,6 +356,38 @@ cJSON_GetArrayItem(cJSON *array, int item);
 /* Get item "string" from object. Case insensitive. */
 extern cJSON *
 cJSON_GetObjectItem(cJSON *object, const char *string);
+/* Same as cJSON_GetObjectItem, but the name has to match exactly. */
+extern cJSON *
+cJSON_GetObjectItemCaseSensitive(cJSON *object, const char *string);
+
+/* A path compiled once, to look up the same value in many trees without
+   splitting the path each time. The path is either a sub-document path
+   like "a.b[3].c", where names containing ".[]`" are quoted in backticks
+   and [-1] is the last element of an array, or a JSON Pointer like
+   "/a/b/3/c". Names match case-sensitively. The empty path is the root.
+   Returns NULL if the path is malformed. */
+typedef struct cJSON_Path cJSON_Path;
+
+extern cJSON_Path *
+cJSON_CompilePath(const char *path);
+extern void
+cJSON_DeletePath(cJSON_Path *path);
+/* Returns the item at the path below item, or NULL if there is none. */
+extern cJSON *
+cJSON_PathGet(const cJSON_Path *path, cJSON *item);
+
+/* Paths compiled together, which share the lookups of their common
+   beginning, and find several members of an object in one walk over it. */
+typedef struct cJSON_PathSet cJSON_PathSet;
+
+extern cJSON_PathSet *
+cJSON_CompilePathSet(const char **paths, int npaths);
+extern void
+cJSON_DeletePathSet(cJSON_PathSet *set);
+/* Store the item at paths[i] below item into values[i], NULL where there is
+   none. Returns the number of items found. */
+extern int
+cJSON_PathSetGet(const cJSON_PathSet *set, cJSON *item, cJSON **values);
 
 /* These calls create a cJSON item of the appropriate type. */
 extern cJSON *
@@ -130,6 +398,9 @@ extern cJSON *
 cJSON_CreateFalse(void);
 extern cJSON *
 cJSON_CreateNumber(double num);
+/* Integers beyond 2^53 keep their exact value, and print without loss. */
+extern cJSON *
+cJSON_CreateInt64(int64_t num);
 extern cJSON *
 cJSON_CreateString(const char *string);
 extern cJSON *
@@ -176,10 +447,41 @@ cJSON_ReplaceItemInArray(cJSON *array, int which, cJSON *newitem);
 extern void
 cJSON_ReplaceItemInObject(cJSON *object, const char *string, cJSON *newitem);
 
+/* Report the changes which turn from into to, as calls of the callback
+   with the sub-document path of the change, like "a.b[2]" with names that
+   contain ".[]`" quoted in backticks. The operations are:
+     CJSON_DIFF_SET     set path to value, adding the member if needed
+     CJSON_DIFF_REMOVE  remove path
+     CJSON_DIFF_APPEND  push value to the end of the array at path
+   A change of type replaces the whole value, and an array is compared
+   position by position, then grown at the end or shrunk from the end, so
+   the changes apply one after another in the order given. The empty path
+   stands for the whole document. Returns 1 on success, and 0 if the
+   callback returned 0, the trees are nested too deep, or memory runs out.
+   It recurses once per level of nesting, see cJSON_SetNestingLimit. */
+#define CJSON_DIFF_SET 0
+#define CJSON_DIFF_REMOVE 1
+#define CJSON_DIFF_APPEND 2
+typedef int (*cJSON_DiffCallback)(void *ctx, int op, const char *path, const cJSON *value);
+
+extern int
+cJSON_Diff(const cJSON *from, const cJSON *to, cJSON_DiffCallback callback, void *ctx);
+
+/* Apply an RFC 7396 JSON merge patch to target, which it modifies in
+   place, and return the patched document. The result is a new item when
+   patch or target is not an object, target is deleted then. The values are
+   copied from patch, recursing once per level of nesting like cJSON_Diff.
+   Returns NULL if memory runs out or the patch is nested too deep. Target
+   still belongs to the caller then, and an object target may be partially
+   patched. */
+extern cJSON *
+cJSON_MergePatch(cJSON *target, const cJSON *patch);
+
 #define cJSON_AddNullToObject(object, name)      cJSON_AddItemToObject(object, name, cJSON_CreateNull())
 #define cJSON_AddTrueToObject(object, name)      cJSON_AddItemToObject(object, name, cJSON_CreateTrue())
 #define cJSON_AddFalseToObject(object, name)             cJSON_AddItemToObject(object, name, cJSON_CreateFalse())
 #define cJSON_AddNumberToObject(object, name, n)  cJSON_AddItemToObject(object, name, cJSON_CreateNumber(n))
+#define cJSON_AddInt64ToObject(object, name, n)   cJSON_AddItemToObject(object, name, cJSON_CreateInt64(n))
 #define cJSON_AddStringToObject(object, name, s)  cJSON_AddItemToObject(object, name, cJSON_CreateString(s))
 
 #ifdef __cplusplus
@@ -0,0 +1,124 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * Decoding a page of profiles, as fetched from the cluster, in both formats: eagerly, and projecting only the names,
+ * as a listing page would, or every field:
+ *
+ *     $ make profile-bench
+ *     $ ./profile-bench [ profiles ]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "avatar.h"
+#include "profile.h"
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *format, const char *what, size_t count, double seconds)
+{
+    printf("%-8s %-22s %10.0f profiles/s %8.2f us/profile\n", format, what, count / seconds, seconds * 1e6 / count);
+}
+
+static void
+bench(const char *format, ProfileSource *sources, size_t count)
+{
+    Profile *profiles = malloc(count * sizeof(Profile));
+    Profile **decoded = malloc(count * sizeof(Profile *));
+    double start;
+    size_t i;
+
+    /* the profiles of the page are all kept until it is rendered */
+    start = now();
+    for (i = 0; i < count; i++) {
+        decoded[i] = decode_profile_with_flags(sources[i].data, sources[i].len, sources[i].flags);
+    }
+    for (i = 0; i < count; i++) {
+        free_profile(decoded[i]);
+    }
+    report(format, "eager decode", count, now() - start);
+
+    start = now();
+    if (project_profiles(sources, count, PROFILE_NAME, profiles) != count) {
+        fprintf(stderr, "failed to project the %s profiles\n", format);
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < count; i++) {
+        clear_profile(&profiles[i]);
+    }
+    report(format, "project names", count, now() - start);
+
+    start = now();
+    project_profiles(sources, count, PROFILE_NAME | PROFILE_AGE | PROFILE_AVATAR, profiles);
+    for (i = 0; i < count; i++) {
+        clear_profile(&profiles[i]);
+    }
+    report(format, "project every field", count, now() - start);
+
+    free(profiles);
+    free(decoded);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static char *names[] = {"Griet", "Vermeer", "Catharina", "Pieter", "Tanneke", "Maria"};
+    size_t i, count = 10000;
+    ProfileSource *json, *binary;
+
+    if (argc > 1) {
+        count = (size_t) atoi(argv[1]);
+    }
+    if (count == 0) {
+        fprintf(stderr, "Usage: %s [ profiles ]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    json = malloc(count * sizeof(ProfileSource));
+    binary = malloc(count * sizeof(ProfileSource));
+    for (i = 0; i < count; i++) {
+        Profile profile = {names[i % 6], (int) (16 + i % 60), avatar_jpg, (int) avatar_jpg_len};
+        json[i].data = encode_profile(&profile);
+        json[i].len = strlen(json[i].data);
+        json[i].flags = PROFILE_FORMAT_JSON;
+        binary[i].data = encode_profile_binary(&profile, &binary[i].len);
+        binary[i].flags = PROFILE_FORMAT_BINARY;
+    }
+
+    bench("json", json, count);
+    bench("binary", binary, count);
+
+    for (i = 0; i < count; i++) {
+        free((char *) json[i].data);
+        free((char *) binary[i].data);
+    }
+    free(json);
+    free(binary);
+    return 0;
+}
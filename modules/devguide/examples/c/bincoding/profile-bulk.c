@@ -0,0 +1,486 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * Bulk import and export of profiles with the transcoders of the bincoding example.
+ *
+ * The profiles are listed in a CSV file with one "image,name,age" line per profile, where image is the name of the
+ * avatar in the directory of images. The profile of "griet.jpg" is stored as "profile-griet". The lines are not
+ * quoted, and a first line which does not end with a number is taken as a header.
+ *
+ *     $ ./profile-bulk import couchbase://localhost/default password Administrator profiles.csv images/ [ binary ]
+ *     $ ./profile-bulk export couchbase://localhost/default password Administrator profiles.csv profiles.html
+ *
+ * The import reads and encodes the profiles on a pool of worker threads, which hand them over to the thread of the
+ * connection through a bounded queue. The export fetches the profiles and renders each of them to the HTML file as it
+ * arrives. In both directions a bounded window of operations is kept in flight: the callback of every completed
+ * operation schedules the next one. Both report documents and megabytes per second.
+ */
+
+#include <stdio.h>
+#include <libcouchbase/couchbase.h>
+#include <libcouchbase/api3.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+
+/* The number of operations in flight, and of worker threads for the import. */
+#define BULK_WINDOW 128
+#define BULK_WORKERS 4
+
+static void
+die(lcb_INSTANCE instance, const char *msg, lcb_error_t err)
+{
+    fprintf(stderr, "%s. Received code 0x%X (%s)\n", msg, err, lcb_strerror(instance, err));
+    exit(EXIT_FAILURE);
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    char *image;
+    char *name;
+    int age;
+    char key[128];
+    size_t len; /* the size of the stored document */
+} Row;
+
+/* Read the lines of the CSV file, or exit. */
+static Row *
+read_rows(const char *filename, size_t *count)
+{
+    FILE *csv = fopen(filename, "r");
+    Row *rows = NULL;
+    size_t capacity = 0, lineno = 0;
+    char line[4096];
+
+    if (!csv) {
+        perror(filename);
+        exit(EXIT_FAILURE);
+    }
+    *count = 0;
+    while (fgets(line, sizeof(line), csv)) {
+        char *image = line, *name, *age, *end, *stem;
+        size_t stem_len;
+        long val;
+
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+        name = strchr(image, ',');
+        age = name ? strchr(name + 1, ',') : NULL;
+        if (age) {
+            *name++ = '\0';
+            *age++ = '\0';
+            val = strtol(age, &end, 10);
+        }
+        if (!age || end == age || *end != '\0') {
+            if (lineno == 1) {
+                continue; /* the header */
+            }
+            fprintf(stderr, "%s:%u: expected \"image,name,age\"\n", filename, (unsigned) lineno);
+            exit(EXIT_FAILURE);
+        }
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            rows = realloc(rows, capacity * sizeof(Row));
+        }
+        rows[*count].image = strdup(image);
+        rows[*count].name = strdup(name);
+        rows[*count].age = (int) val;
+        stem = strrchr(image, '/') ? strrchr(image, '/') + 1 : image;
+        stem_len = strchr(stem, '.') ? (size_t) (strchr(stem, '.') - stem) : strlen(stem);
+        snprintf(rows[*count].key, sizeof(rows[*count].key), "profile-%.*s", (int) stem_len, stem);
+        (*count)++;
+    }
+    fclose(csv);
+    return rows;
+}
+
+static void
+free_rows(Row *rows, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++) {
+        free(rows[i].image);
+        free(rows[i].name);
+    }
+    free(rows);
+}
+
+static void *
+read_file(const char *dir, const char *name, size_t *len)
+{
+    char path[4096];
+    FILE *file;
+    void *data = NULL;
+    long size;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return NULL;
+    }
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        data = malloc(size ? size : 1);
+        if (data && fread(data, 1, size, file) != (size_t) size) {
+            free(data);
+            data = NULL;
+        }
+        *len = (size_t) size;
+    }
+    if (!data) {
+        fprintf(stderr, "%s: failed to read\n", path);
+    }
+    fclose(file);
+    return data;
+}
+
+/* An encoded profile, on its way from the workers to the connection. */
+typedef struct {
+    Row *row;
+    char *value;
+    size_t len;
+} Item;
+
+typedef struct {
+    lcb_INSTANCE instance;
+    Row *rows;
+    size_t nrows;
+    int binary;
+    const char *images;
+    FILE *html;
+
+    /* the queue of encoded profiles, and the next row for the workers */
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    Item queue[2 * BULK_WINDOW];
+    size_t head;
+    size_t queued;
+    size_t next_row;
+    int workers;
+    size_t unreadable; /* the rows the workers could not read */
+
+    size_t inflight;
+    size_t next_get;
+    size_t docs;
+    size_t bytes;
+    size_t failed;
+} Bulk;
+
+static void *
+encode_worker(void *arg)
+{
+    Bulk *bulk = arg;
+    size_t i, avatar_len;
+    Item item;
+
+    for (;;) {
+        pthread_mutex_lock(&bulk->lock);
+        i = bulk->next_row++;
+        pthread_mutex_unlock(&bulk->lock);
+        if (i >= bulk->nrows) {
+            break;
+        }
+
+        item.row = &bulk->rows[i];
+        item.value = NULL;
+        {
+            Profile profile = {bulk->rows[i].name, bulk->rows[i].age, NULL, 0};
+            profile.avatar = read_file(bulk->images, bulk->rows[i].image, &avatar_len);
+            if (profile.avatar) {
+                profile.avatar_len = (int) avatar_len;
+                if (bulk->binary) {
+                    item.value = encode_profile_binary(&profile, &item.len);
+                } else {
+                    item.value = encode_profile(&profile);
+                    item.len = item.value ? strlen(item.value) : 0;
+                }
+                free(profile.avatar);
+            }
+        }
+
+        pthread_mutex_lock(&bulk->lock);
+        if (item.value) {
+            while (bulk->queued == sizeof(bulk->queue) / sizeof(bulk->queue[0])) {
+                pthread_cond_wait(&bulk->not_full, &bulk->lock);
+            }
+            bulk->queue[(bulk->head + bulk->queued++) % (sizeof(bulk->queue) / sizeof(bulk->queue[0]))] = item;
+            pthread_cond_signal(&bulk->not_empty);
+        } else {
+            bulk->unreadable++;
+        }
+        pthread_mutex_unlock(&bulk->lock);
+    }
+
+    pthread_mutex_lock(&bulk->lock);
+    bulk->workers--;
+    pthread_cond_broadcast(&bulk->not_empty);
+    pthread_mutex_unlock(&bulk->lock);
+    return NULL;
+}
+
+/* Take the next encoded profile. With wait, block until there is one or the workers are done. */
+static int
+pop_item(Bulk *bulk, Item *item, int wait)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&bulk->lock);
+    while (wait && bulk->queued == 0 && bulk->workers > 0) {
+        pthread_cond_wait(&bulk->not_empty, &bulk->lock);
+    }
+    if (bulk->queued > 0) {
+        *item = bulk->queue[bulk->head];
+        bulk->head = (bulk->head + 1) % (sizeof(bulk->queue) / sizeof(bulk->queue[0]));
+        bulk->queued--;
+        pthread_cond_signal(&bulk->not_full);
+        found = 1;
+    }
+    pthread_mutex_unlock(&bulk->lock);
+    return found;
+}
+
+/* Fill the window with stores. When nothing is in flight, wait for the workers. Returns the number scheduled. */
+static size_t
+schedule_stores(Bulk *bulk, int wait)
+{
+    size_t scheduled = 0;
+    lcb_error_t err;
+    Item item;
+
+    lcb_sched_enter(bulk->instance);
+    while (bulk->inflight < BULK_WINDOW && pop_item(bulk, &item, wait && bulk->inflight == 0)) {
+        lcb_CMDSTORE cmd = {0};
+        LCB_CMD_SET_KEY(&cmd, item.row->key, strlen(item.row->key));
+        LCB_CMD_SET_VALUE(&cmd, item.value, item.len);
+        cmd.operation = LCB_SET;
+        cmd.flags = bulk->binary ? PROFILE_FORMAT_BINARY : PROFILE_FORMAT_JSON;
+        cmd.datatype = bulk->binary ? LCB_VALUE_RAW : LCB_VALUE_F_JSON;
+        err = lcb_store3(bulk->instance, item.row, &cmd);
+        free(item.value); /* the value has been copied by the library */
+        if (err != LCB_SUCCESS) {
+            die(bulk->instance, "Couldn't schedule storage operation", err);
+        }
+        bulk->inflight++;
+        item.row->len = item.len;
+        scheduled++;
+    }
+    lcb_sched_leave(bulk->instance);
+    return scheduled;
+}
+
+static void
+store_callback(lcb_INSTANCE instance, int cbtype, const lcb_RESPBASE *rb)
+{
+    Bulk *bulk = (Bulk *) lcb_get_cookie(instance);
+    const Row *row = (const Row *) rb->cookie;
+
+    (void) cbtype;
+    bulk->inflight--;
+    if (rb->rc == LCB_SUCCESS) {
+        bulk->docs++;
+        bulk->bytes += row->len;
+    } else {
+        fprintf(stderr, "Failed to store \"%.*s\": %s\n", (int) rb->nkey, (const char *) rb->key,
+                lcb_strerror(instance, rb->rc));
+        bulk->failed++;
+    }
+    schedule_stores(bulk, 0);
+}
+
+static void
+schedule_gets(Bulk *bulk)
+{
+    lcb_error_t err;
+
+    lcb_sched_enter(bulk->instance);
+    while (bulk->inflight < BULK_WINDOW && bulk->next_get < bulk->nrows) {
+        lcb_CMDGET cmd = {0};
+        const Row *row = &bulk->rows[bulk->next_get++];
+        LCB_CMD_SET_KEY(&cmd, row->key, strlen(row->key));
+        err = lcb_get3(bulk->instance, row, &cmd);
+        if (err != LCB_SUCCESS) {
+            die(bulk->instance, "Couldn't schedule retrieval operation", err);
+        }
+        bulk->inflight++;
+    }
+    lcb_sched_leave(bulk->instance);
+}
+
+/* Render the profile as soon as it arrives, the value is only valid during the call. */
+static void
+get_callback(lcb_INSTANCE instance, int cbtype, const lcb_RESPBASE *rb)
+{
+    Bulk *bulk = (Bulk *) lcb_get_cookie(instance);
+    const lcb_RESPGET *rg = (const lcb_RESPGET *) rb;
+    ProfileView profile;
+    const char *name;
+
+    (void) cbtype;
+    bulk->inflight--;
+    if (rb->rc != LCB_SUCCESS) {
+        fprintf(stderr, "Failed to fetch \"%.*s\": %s\n", (int) rb->nkey, (const char *) rb->key,
+                lcb_strerror(instance, rb->rc));
+        bulk->failed++;
+    } else if (!profile_view_init(&profile, rg->value, rg->nvalue, rg->itmflags)) {
+        fprintf(stderr, "The profile \"%.*s\" is malformed or has unknown format (flags: 0x%08X)\n",
+                (int) rb->nkey, (const char *) rb->key, (unsigned) rg->itmflags);
+        bulk->failed++;
+    } else {
+        fprintf(bulk->html, "<div><img src=\"data:image/jpeg;base64,");
+        if (profile_view_write_avatar_base64(&profile, bulk->html)) {
+            name = profile_view_name(&profile);
+            fprintf(bulk->html, "\"><br><b>NAME:</b> %s<br><b>AGE:</b> %d</div>\n", name ? name : "",
+                    profile_view_age(&profile));
+            bulk->docs++;
+            bulk->bytes += rg->nvalue;
+        } else {
+            /* nothing of the avatar was written, the element is closed empty */
+            fprintf(bulk->html, "\"></div>\n");
+            fprintf(stderr, "The avatar of the profile \"%.*s\" is not base64\n", (int) rb->nkey,
+                    (const char *) rb->key);
+            bulk->failed++;
+        }
+        profile_view_free(&profile);
+    }
+    schedule_gets(bulk);
+}
+
+static void
+report(const char *what, const Bulk *bulk, double seconds)
+{
+    fprintf(stderr, "%s %u profiles (%u failed) in %.2f s: %.0f docs/s, %.1f MB/s\n", what, (unsigned) bulk->docs,
+            (unsigned) (bulk->failed + bulk->unreadable), seconds, bulk->docs / seconds, bulk->bytes / seconds / (1024 * 1024));
+}
+
+static void
+import_profiles(Bulk *bulk)
+{
+    pthread_t workers[BULK_WORKERS];
+    double start = now();
+    int i;
+
+    lcb_install_callback3(bulk->instance, LCB_CALLBACK_STORE, store_callback);
+    bulk->workers = BULK_WORKERS;
+    for (i = 0; i < BULK_WORKERS; i++) {
+        if (pthread_create(&workers[i], NULL, encode_worker, bulk) != 0) {
+            perror("failed to start worker");
+            exit(EXIT_FAILURE);
+        }
+    }
+    /* the callbacks keep the window full, until the queue runs dry */
+    while (schedule_stores(bulk, 1) > 0) {
+        lcb_wait(bulk->instance);
+    }
+    for (i = 0; i < BULK_WORKERS; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    report("Imported", bulk, now() - start);
+}
+
+static void
+export_profiles(Bulk *bulk, const char *filename)
+{
+    double start = now();
+
+    bulk->html = fopen(filename, "w");
+    if (!bulk->html) {
+        perror(filename);
+        exit(EXIT_FAILURE);
+    }
+    lcb_install_callback3(bulk->instance, LCB_CALLBACK_GET, get_callback);
+    fprintf(bulk->html, "<html><body>\n");
+    schedule_gets(bulk);
+    lcb_wait(bulk->instance);
+    fprintf(bulk->html, "</body></html>\n");
+    fclose(bulk->html);
+    report("Exported", bulk, now() - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+    lcb_error_t err;
+    struct lcb_create_st create_options = {0};
+    Bulk bulk = {0};
+    int import;
+
+    if (argc < 7 || (strcmp(argv[1], "import") != 0 && strcmp(argv[1], "export") != 0)) {
+        fprintf(stderr,
+                "Usage: %s import couchbase://host/bucket password username profiles.csv images [ json | binary ]\n"
+                "       %s export couchbase://host/bucket password username profiles.csv profiles.html\n",
+                argv[0], argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    import = strcmp(argv[1], "import") == 0;
+    bulk.rows = read_rows(argv[5], &bulk.nrows);
+    bulk.images = argv[6];
+    bulk.binary = import && argc > 7 && strcmp(argv[7], "binary") == 0;
+    pthread_mutex_init(&bulk.lock, NULL);
+    pthread_cond_init(&bulk.not_empty, NULL);
+    pthread_cond_init(&bulk.not_full, NULL);
+
+    create_options.version = 3;
+    create_options.v.v3.connstr = argv[2];
+    create_options.v.v3.passwd = argv[3];
+    create_options.v.v3.username = argv[4];
+
+    err = lcb_create(&bulk.instance, &create_options);
+    if (err != LCB_SUCCESS) {
+        die(NULL, "Couldn't create couchbase handle", err);
+    }
+    /* the callbacks get the bulk from the instance, and the row of their operation from its cookie */
+    lcb_set_cookie(bulk.instance, &bulk);
+    err = lcb_connect(bulk.instance);
+    if (err != LCB_SUCCESS) {
+        die(bulk.instance, "Couldn't schedule connection", err);
+    }
+    lcb_wait(bulk.instance);
+    err = lcb_get_bootstrap_status(bulk.instance);
+    if (err != LCB_SUCCESS) {
+        die(bulk.instance, "Couldn't bootstrap from cluster", err);
+    }
+
+    if (import) {
+        import_profiles(&bulk);
+    } else {
+        export_profiles(&bulk, argv[6]);
+    }
+
+    lcb_destroy(bulk.instance);
+    pthread_mutex_destroy(&bulk.lock);
+    pthread_cond_destroy(&bulk.not_empty);
+    pthread_cond_destroy(&bulk.not_full);
+    free_rows(bulk.rows, bulk.nrows);
+    return bulk.failed || bulk.unreadable ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,499 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * The transcoders of the profiles: JSON with the avatar in base64, the compact binary layout, and the lazy views which
+ * decode the fields of either of them on demand.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base64.h"
+#include "cJSON.h"
+#include "profile.h"
+
+Profile *
+new_profile(void)
+{
+    return calloc(1, sizeof(Profile));
+}
+
+void
+clear_profile(Profile *profile)
+{
+    free(profile->name);
+    free(profile->avatar);
+    memset(profile, 0, sizeof(Profile));
+}
+
+void
+free_profile(Profile *profile)
+{
+    if (profile) {
+        clear_profile(profile);
+    }
+    free(profile);
+}
+
+/* The binary layout starts with this magic and a version, followed by the age, the length of the name, the name, the
+ * length of the avatar and the avatar. The integers are 32-bit big-endian. */
+#define PROFILE_BINARY_MAGIC "PRF\x01"
+#define PROFILE_BINARY_HEADER 4
+
+static unsigned char *
+put_u32(unsigned char *ptr, uint32_t val)
+{
+    ptr[0] = (unsigned char) (val >> 24);
+    ptr[1] = (unsigned char) (val >> 16);
+    ptr[2] = (unsigned char) (val >> 8);
+    ptr[3] = (unsigned char) val;
+    return ptr + 4;
+}
+
+static const unsigned char *
+get_u32(const unsigned char *ptr, uint32_t *val)
+{
+    *val = (uint32_t) ptr[0] << 24 | (uint32_t) ptr[1] << 16 | (uint32_t) ptr[2] << 8 | ptr[3];
+    return ptr + 4;
+}
+
+Profile *
+decode_profile(const char *data, size_t len)
+{
+    Profile *profile = NULL;
+    cJSON *json = cJSON_ParseWithLength(data, len);
+
+    if (json) {
+        cJSON *val;
+
+        profile = new_profile();
+        val = cJSON_GetObjectItem(json, "name");
+        if (val && val->type == cJSON_String) {
+            profile->name = strdup(val->valuestring);
+        }
+        val = cJSON_GetObjectItem(json, "age");
+        if (val && val->type == cJSON_Number) {
+            profile->age = val->valueint;
+        }
+        val = cJSON_GetObjectItem(json, "avatar");
+        if (val && val->type == cJSON_String) {
+            profile->avatar = unbase64(val->valuestring, strlen(val->valuestring),
+                    &profile->avatar_len);
+        }
+        cJSON_Delete(json);
+    }
+    return profile;
+}
+
+char *
+encode_profile(Profile *profile)
+{
+    cJSON *json = cJSON_CreateObject();
+    if (profile->name) {
+        cJSON *val = cJSON_CreateString(profile->name);
+        cJSON_AddItemToObject(json, "name", val);
+    }
+    if (profile->age) {
+        cJSON *val = cJSON_CreateNumber(profile->age);
+        cJSON_AddItemToObject(json, "age", val);
+    }
+    if (profile->avatar_len > 0 && profile->avatar) {
+        cJSON *val;
+        char *b64_val;
+        int b64_len = 0;
+        b64_val = base64(profile->avatar, profile->avatar_len, &b64_len);
+        val = cJSON_CreateString(b64_val);
+        cJSON_AddItemToObject(json, "avatar", val);
+        free(b64_val);
+    }
+    {
+        char *out = cJSON_PrintUnformatted(json);
+        cJSON_Delete(json);
+        return out;
+    }
+}
+
+Profile *
+decode_profile_binary(const char *data, size_t len)
+{
+    const unsigned char *ptr = (const unsigned char *) data, *end = ptr + len;
+    Profile *profile;
+    uint32_t age, name_len, avatar_len;
+
+    if (len < PROFILE_BINARY_HEADER + 12 || memcmp(ptr, PROFILE_BINARY_MAGIC, PROFILE_BINARY_HEADER) != 0) {
+        return NULL;
+    }
+    ptr = get_u32(ptr + PROFILE_BINARY_HEADER, &age);
+    ptr = get_u32(ptr, &name_len);
+    if (name_len > (size_t) (end - ptr) - 4) {
+        return NULL;
+    }
+    profile = new_profile();
+    profile->age = (int) age;
+    profile->name = malloc(name_len + 1);
+    memcpy(profile->name, ptr, name_len);
+    profile->name[name_len] = '\0';
+    ptr = get_u32(ptr + name_len, &avatar_len);
+    if (avatar_len != (size_t) (end - ptr)) {
+        free_profile(profile);
+        return NULL;
+    }
+    if (avatar_len > 0) {
+        profile->avatar = malloc(avatar_len);
+        memcpy(profile->avatar, ptr, avatar_len);
+        profile->avatar_len = (int) avatar_len;
+    }
+    return profile;
+}
+
+char *
+encode_profile_binary(Profile *profile, size_t *len)
+{
+    size_t name_len = profile->name ? strlen(profile->name) : 0;
+    size_t avatar_len = profile->avatar ? (size_t) profile->avatar_len : 0;
+    unsigned char *out, *ptr;
+
+    *len = PROFILE_BINARY_HEADER + 12 + name_len + avatar_len;
+    out = malloc(*len);
+    memcpy(out, PROFILE_BINARY_MAGIC, PROFILE_BINARY_HEADER);
+    ptr = put_u32(out + PROFILE_BINARY_HEADER, (uint32_t) profile->age);
+    ptr = put_u32(ptr, (uint32_t) name_len);
+    memcpy(ptr, profile->name, name_len);
+    ptr = put_u32(ptr + name_len, (uint32_t) avatar_len);
+    memcpy(ptr, profile->avatar, avatar_len);
+    return (char *) out;
+}
+
+Profile *
+decode_profile_with_flags(const char *data, size_t len, uint32_t flags)
+{
+    switch (flags & PROFILE_FORMAT_MASK) {
+        case PROFILE_FORMAT_BINARY:
+            return decode_profile_binary(data, len);
+        case PROFILE_FORMAT_JSON:
+        case 0:
+            return decode_profile(data, len);
+        default:
+            return NULL;
+    }
+}
+
+void
+write_base64(FILE *file, const void *data, size_t len)
+{
+    const char *ptr = data;
+    char out[4096];
+    base64_state state;
+    size_t n;
+
+    base64_encode_init(&state);
+    while (len > 0) {
+        n = len < 3072 ? len : 3072;
+        fwrite(out, 1, base64_encode_update(&state, ptr, n, out), file);
+        ptr += n;
+        len -= n;
+    }
+    fwrite(out, 1, base64_encode_final(&state, out), file);
+}
+
+/* Collects the members of the root object of a JSON profile. */
+typedef struct {
+    ProfileView *view;
+    const char *data;
+    const char *end;
+    int depth;
+    unsigned field; /* the PROFILE_* field of the current member */
+} view_scan;
+
+static int
+view_start(void *ctx)
+{
+    ((view_scan *) ctx)->depth++;
+    return 1;
+}
+
+static int
+view_end(void *ctx)
+{
+    ((view_scan *) ctx)->depth--;
+    return 1;
+}
+
+static int
+view_key(void *ctx, const char *str, size_t len)
+{
+    view_scan *scan = ctx;
+
+    scan->field = 0;
+    if (scan->depth == 1) {
+        if (len == 4 && memcmp(str, "name", 4) == 0) {
+            scan->field = PROFILE_NAME;
+        } else if (len == 3 && memcmp(str, "age", 3) == 0) {
+            scan->field = PROFILE_AGE;
+        } else if (len == 6 && memcmp(str, "avatar", 6) == 0) {
+            scan->field = PROFILE_AVATAR;
+        }
+    }
+    return 1;
+}
+
+static int
+view_string(void *ctx, const char *str, size_t len)
+{
+    view_scan *scan = ctx;
+    ProfileView *view = scan->view;
+    unsigned field = scan->depth == 1 ? scan->field : 0;
+
+    if (field != PROFILE_NAME && field != PROFILE_AVATAR) {
+        return 1;
+    }
+    if (view->copied & field) {
+        free((char *) (field == PROFILE_NAME ? view->name : view->avatar));
+        view->copied &= ~field;
+    }
+    /* the strings with escapes are decoded out of the document, and only valid during the call */
+    if (str < scan->data || str >= scan->end) {
+        char *copy = malloc(len + 1);
+        if (!copy) {
+            return 0;
+        }
+        memcpy(copy, str, len);
+        str = copy;
+        view->copied |= field;
+    }
+    if (field == PROFILE_NAME) {
+        view->name = str;
+        view->name_len = len;
+    } else {
+        view->avatar = str;
+        view->avatar_len = len;
+    }
+    view->present |= field;
+    return 1;
+}
+
+static int
+view_number(void *ctx, double value, const char *str, size_t len)
+{
+    view_scan *scan = ctx;
+
+    (void) str;
+    (void) len;
+    if (scan->depth == 1 && scan->field == PROFILE_AGE) {
+        /* saturated as cJSON saturates valueint, so that it agrees with the eager decoder */
+        if (value >= INT_MAX) {
+            scan->view->age = INT_MAX;
+        } else if (value <= INT_MIN) {
+            scan->view->age = INT_MIN;
+        } else {
+            scan->view->age = (int) value;
+        }
+        scan->view->present |= PROFILE_AGE;
+    }
+    return 1;
+}
+
+int
+profile_view_init(ProfileView *view, const char *data, size_t len, uint32_t flags)
+{
+    static const cJSON_SAXHandler handler = {view_start, view_end, view_start, view_end, view_key,
+                                             view_string, view_number, NULL, NULL, NULL};
+    const unsigned char *ptr, *end;
+    uint32_t age, name_len, avatar_len;
+    view_scan scan;
+
+    memset(view, 0, sizeof(ProfileView));
+    switch (flags & PROFILE_FORMAT_MASK) {
+        case PROFILE_FORMAT_JSON:
+        case 0:
+            scan.view = view;
+            scan.data = data;
+            scan.end = data + len;
+            scan.depth = 0;
+            scan.field = 0;
+            view->avatar_base64 = 1;
+            if (!cJSON_ParseSAX(data, len, &handler, &scan)) {
+                profile_view_free(view);
+                return 0;
+            }
+            return 1;
+
+        case PROFILE_FORMAT_BINARY:
+            ptr = (const unsigned char *) data;
+            end = ptr + len;
+            if (len < PROFILE_BINARY_HEADER + 12 || memcmp(ptr, PROFILE_BINARY_MAGIC, PROFILE_BINARY_HEADER) != 0) {
+                return 0;
+            }
+            ptr = get_u32(ptr + PROFILE_BINARY_HEADER, &age);
+            ptr = get_u32(ptr, &name_len);
+            if (name_len > (size_t) (end - ptr) - 4) {
+                return 0;
+            }
+            view->name = (const char *) ptr;
+            view->name_len = name_len;
+            ptr = get_u32(ptr + name_len, &avatar_len);
+            if (avatar_len != (size_t) (end - ptr)) {
+                return 0;
+            }
+            view->avatar = (const char *) ptr;
+            view->avatar_len = avatar_len;
+            view->age = (int) age;
+            view->present = PROFILE_NAME | PROFILE_AGE | (avatar_len ? PROFILE_AVATAR : 0);
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+const char *
+profile_view_name(ProfileView *view)
+{
+    if (!(view->present & PROFILE_NAME)) {
+        return NULL;
+    }
+    if (!(view->decoded & PROFILE_NAME)) {
+        view->decoded_name = malloc(view->name_len + 1);
+        if (!view->decoded_name) {
+            return NULL;
+        }
+        memcpy(view->decoded_name, view->name, view->name_len);
+        view->decoded_name[view->name_len] = '\0';
+        view->decoded |= PROFILE_NAME;
+    }
+    return view->decoded_name;
+}
+
+int
+profile_view_age(ProfileView *view)
+{
+    return view->age;
+}
+
+const void *
+profile_view_avatar(ProfileView *view, int *len)
+{
+    *len = 0;
+    if (!(view->present & PROFILE_AVATAR)) {
+        return NULL;
+    }
+    if (!view->avatar_base64) {
+        *len = (int) view->avatar_len;
+        return view->avatar;
+    }
+    if (!(view->decoded & PROFILE_AVATAR)) {
+        view->decoded_avatar = unbase64(view->avatar, (int) view->avatar_len, &view->decoded_avatar_len);
+        if (!view->decoded_avatar) {
+            return NULL;
+        }
+        view->decoded |= PROFILE_AVATAR;
+    }
+    *len = view->decoded_avatar_len;
+    return view->decoded_avatar;
+}
+
+/* Whether the text is base64, decoded in chunks and dropped. */
+static int
+is_base64(const char *text, size_t len)
+{
+    char out[3075];
+    base64_state state;
+    size_t n;
+
+    base64_decode_init(&state);
+    while (len > 0) {
+        n = len < 4096 ? len : 4096;
+        if (base64_decode_update(&state, text, n, out) == BASE64_INVALID) {
+            return 0;
+        }
+        text += n;
+        len -= n;
+    }
+    return base64_decode_final(&state, out) != BASE64_INVALID;
+}
+
+int
+profile_view_write_avatar_base64(ProfileView *view, FILE *file)
+{
+    if (!(view->present & PROFILE_AVATAR)) {
+        return 1;
+    }
+    if (view->avatar_base64) {
+        /* the text of the document is written as it is, so it must not carry anything but base64 */
+        if (!is_base64(view->avatar, view->avatar_len)) {
+            return 0;
+        }
+        fwrite(view->avatar, 1, view->avatar_len, file);
+    } else {
+        write_base64(file, view->avatar, view->avatar_len);
+    }
+    return 1;
+}
+
+void
+profile_view_free(ProfileView *view)
+{
+    if (view->copied & PROFILE_NAME) {
+        free((char *) view->name);
+    }
+    if (view->copied & PROFILE_AVATAR) {
+        free((char *) view->avatar);
+    }
+    free(view->decoded_name);
+    free(view->decoded_avatar);
+    memset(view, 0, sizeof(ProfileView));
+}
+
+size_t
+project_profiles(const ProfileSource *sources, size_t count, unsigned fields, Profile *profiles)
+{
+    ProfileView view;
+    size_t i, decoded = 0;
+    const void *avatar;
+    int len;
+
+    for (i = 0; i < count; i++) {
+        memset(&profiles[i], 0, sizeof(Profile));
+        if (!profile_view_init(&view, sources[i].data, sources[i].len, sources[i].flags)) {
+            continue;
+        }
+        /* the decoded fields are handed over to the profile */
+        if ((fields & PROFILE_NAME) && profile_view_name(&view)) {
+            profiles[i].name = view.decoded_name;
+            view.decoded_name = NULL;
+        }
+        if (fields & PROFILE_AGE) {
+            profiles[i].age = profile_view_age(&view);
+        }
+        if ((fields & PROFILE_AVATAR) && (avatar = profile_view_avatar(&view, &len)) != NULL) {
+            if (view.decoded_avatar) {
+                profiles[i].avatar = view.decoded_avatar;
+                view.decoded_avatar = NULL;
+            } else if ((profiles[i].avatar = malloc(len)) != NULL) {
+                memcpy(profiles[i].avatar, avatar, len);
+            }
+            profiles[i].avatar_len = profiles[i].avatar ? len : 0;
+        }
+        profile_view_free(&view);
+        decoded++;
+    }
+    return decoded;
+}
@@ -0,0 +1,114 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct {
+    char *name;
+    int age;
+    void *avatar;
+    int avatar_len;
+} Profile;
+
+/* The format of the documents, in the common flags of the SDKs. */
+#define PROFILE_FORMAT_MASK 0xFF000000
+#define PROFILE_FORMAT_JSON 0x02000000
+#define PROFILE_FORMAT_BINARY 0x03000000
+
+Profile *
+new_profile(void);
+
+void
+free_profile(Profile *profile);
+
+/* Release the fields of the profile, and empty it. */
+void
+clear_profile(Profile *profile);
+
+/* JSON with the avatar encoded in base64, friendly to the indexers. */
+Profile *
+decode_profile(const char *data, size_t len);
+
+char *
+encode_profile(Profile *profile);
+
+/* The compact binary layout, with the raw avatar. */
+Profile *
+decode_profile_binary(const char *data, size_t len);
+
+char *
+encode_profile_binary(Profile *profile, size_t *len);
+
+/* Pick the decoder from the flags of the document. The documents stored
+   without flags are JSON. */
+Profile *
+decode_profile_with_flags(const char *data, size_t len, uint32_t flags);
+
+/* Write the data as base64 in chunks, without holding all of it encoded. */
+void
+write_base64(FILE *file, const void *data, size_t len);
+
+/* The fields of a profile, for the lazy views and the projections. */
+#define PROFILE_NAME 1
+#define PROFILE_AGE 2
+#define PROFILE_AVATAR 4
+
+/* A profile decoded on demand. The view keeps pointers to the fields in
+   the document, which must outlive it, and decodes each of them on its
+   first access. The fields of JSON documents only get copied when they
+   have escapes. */
+typedef struct {
+    unsigned present;  /* the fields found in the document */
+    unsigned decoded;  /* the fields decoded so far */
+    unsigned copied;   /* the fields copied out of the document */
+    const char *name;
+    size_t name_len;
+    const char *avatar;
+    size_t avatar_len;
+    int avatar_base64; /* the avatar is base64 text */
+    int age;
+    char *decoded_name;
+    void *decoded_avatar;
+    int decoded_avatar_len;
+} ProfileView;
+
+/* Find the fields of the document, without decoding them. Returns 0 if
+   the document is malformed or of unknown format. */
+int
+profile_view_init(ProfileView *view, const char *data, size_t len, uint32_t flags);
+
+/* The name, or NULL. */
+const char *
+profile_view_name(ProfileView *view);
+
+int
+profile_view_age(ProfileView *view);
+
+/* The raw avatar, or NULL. The avatar of a binary document is not copied. */
+const void *
+profile_view_avatar(ProfileView *view, int *len);
+
+/* Write the avatar as base64. The base64 text of a JSON document is written
+   as it is, without decoding it, once it is checked. Returns 0 and writes
+   nothing if the text is not base64. */
+int
+profile_view_write_avatar_base64(ProfileView *view, FILE *file);
+
+void
+profile_view_free(ProfileView *view);
+
+typedef struct {
+    const char *data;
+    size_t len;
+    uint32_t flags;
+} ProfileSource;
+
+/* Decode only the given PROFILE_* fields of count documents into profiles,
+   to be released with clear_profile. The profiles of the malformed
+   documents are left empty. Returns the number of documents decoded. */
+size_t
+project_profiles(const ProfileSource *sources, size_t count, unsigned fields, Profile *profiles);
+
+#endif
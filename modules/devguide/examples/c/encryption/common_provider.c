@@ -15,8 +15,12 @@
  *   limitations under the License.
  */
 
+#include <stdlib.h>
+#include <string.h>
 #include "common_provider.h"
 
+#include <openssl/rand.h>
+
 /**
  *
  *
@@ -74,3 +78,98 @@ char *common_rsa_public_key = "-----BEGIN PUBLIC KEY-----\n"
                               "MQsjTdIQR6oQZgaKRlVzPzHlJgp0tISJxvJYXrct7ZEjEFtTLnOMx4E7MbmcN3bs\n"
                               "DwIDAQAB\n"
                               "-----END PUBLIC KEY-----\n";
+
+lcb_error_t
+common_gcm_generate_iv(uint8_t **iv, size_t *iv_len)
+{
+    *iv_len = AES256_GCM_IV_SIZE;
+    *iv = malloc(*iv_len);
+    if (RAND_bytes(*iv, *iv_len) != 1) {
+        free(*iv);
+        *iv = NULL;
+        return LCB_EINVAL;
+    }
+    return LCB_SUCCESS;
+}
+
+lcb_error_t
+common_gcm_seal(EVP_CIPHER_CTX *ctx, const uint8_t *key, const uint8_t *iv, size_t iv_len, const uint8_t *prefix,
+        size_t prefix_len, const uint8_t *input, size_t input_len, uint8_t **output, size_t *output_len)
+{
+    int rc, len, out_len;
+    uint8_t *out, *cipher;
+
+    if (iv_len != AES256_GCM_IV_SIZE) {
+        return LCB_EINVAL;
+    }
+    rc = EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv);
+    if (rc != 1) {
+        return LCB_EINVAL;
+    }
+    /* a stream mode: the ciphertext is as long as the input, without padding */
+    out = malloc(prefix_len + input_len + AES256_GCM_TAG_SIZE);
+    if (prefix_len) {
+        memcpy(out, prefix, prefix_len);
+    }
+    cipher = out + prefix_len;
+    rc = EVP_EncryptUpdate(ctx, cipher, &len, input, input_len);
+    if (rc != 1) {
+        free(out);
+        return LCB_EINVAL;
+    }
+    out_len = len;
+    rc = EVP_EncryptFinal_ex(ctx, cipher + len, &len);
+    if (rc != 1) {
+        free(out);
+        return LCB_EINVAL;
+    }
+    out_len += len;
+    rc = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AES256_GCM_TAG_SIZE, cipher + out_len);
+    if (rc != 1) {
+        free(out);
+        return LCB_EINVAL;
+    }
+    *output = out;
+    *output_len = prefix_len + out_len + AES256_GCM_TAG_SIZE;
+    return LCB_SUCCESS;
+}
+
+lcb_error_t
+common_gcm_open(EVP_CIPHER_CTX *ctx, const uint8_t *key, const uint8_t *iv, size_t iv_len, const uint8_t *input,
+        size_t input_len, uint8_t **output, size_t *output_len)
+{
+    int rc, len, out_len;
+    size_t cipher_len;
+    uint8_t *out;
+
+    if (iv_len != AES256_GCM_IV_SIZE || input_len < AES256_GCM_TAG_SIZE) {
+        return LCB_EINVAL;
+    }
+    cipher_len = input_len - AES256_GCM_TAG_SIZE;
+    rc = EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv);
+    if (rc != 1) {
+        return LCB_EINVAL;
+    }
+    rc = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, AES256_GCM_TAG_SIZE, (void *) (input + cipher_len));
+    if (rc != 1) {
+        return LCB_EINVAL;
+    }
+    /* one more byte, so that an empty field still gets a buffer */
+    out = malloc(cipher_len + 1);
+    rc = EVP_DecryptUpdate(ctx, out, &len, input, cipher_len);
+    if (rc != 1) {
+        free(out);
+        return LCB_EINVAL;
+    }
+    out_len = len;
+    /* fails when the tag does not match, and the plaintext must then be dropped */
+    rc = EVP_DecryptFinal_ex(ctx, out + len, &len);
+    if (rc != 1) {
+        free(out);
+        return LCB_EINVAL;
+    }
+    out_len += len;
+    *output = out;
+    *output_len = out_len;
+    return LCB_SUCCESS;
+}
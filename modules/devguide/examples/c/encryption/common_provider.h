@@ -19,11 +19,14 @@
 #define _COMMON_PROVIDER_H
 
 #include <libcouchbase/couchbase.h>
+#include <openssl/evp.h>
 
 extern char *common_aes256_key_id;
 
 #define AES256_KEY_SIZE 32
 #define AES256_IV_SIZE 16
+#define AES256_GCM_IV_SIZE 12
+#define AES256_GCM_TAG_SIZE 16
 
 extern uint8_t common_aes256_key[AES256_KEY_SIZE];
 extern uint8_t common_aes256_iv[AES256_IV_SIZE];
@@ -36,4 +39,23 @@ extern char *common_rsa_public_key;
 extern char *common_rsa_private_key_id;
 extern char *common_rsa_public_key_id;
 
+/**
+ * AES-256-GCM, for the providers which encrypt with it. The contexts are initialized for AES-256-GCM in their
+ * direction, and a NULL key keeps the key they have.
+ */
+
+/* A random IV, which GCM needs for every field encrypted with the same key. */
+lcb_error_t
+common_gcm_generate_iv(uint8_t **iv, size_t *iv_len);
+
+/* Encrypt input into prefix | ciphertext | tag. */
+lcb_error_t
+common_gcm_seal(EVP_CIPHER_CTX *ctx, const uint8_t *key, const uint8_t *iv, size_t iv_len, const uint8_t *prefix,
+        size_t prefix_len, const uint8_t *input, size_t input_len, uint8_t **output, size_t *output_len);
+
+/* Decrypt ciphertext | tag, and fail if the tag does not match. */
+lcb_error_t
+common_gcm_open(EVP_CIPHER_CTX *ctx, const uint8_t *key, const uint8_t *iv, size_t iv_len, const uint8_t *input,
+        size_t input_len, uint8_t **output, size_t *output_len);
+
 #endif
@@ -0,0 +1,266 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * Fields per second encrypted and decrypted by the asymmetric provider with its cached keys, against parsing the PEM
+ * keys for every field as it used to. Then documents per second of the envelope provider, against RSA for every field,
+ * and for every block of the fields larger than RSA allows. It calls the providers directly, and does not need a
+ * cluster:
+ *
+ *     $ make openssl_asymmetric_bench
+ *     $ ./openssl_asymmetric_bench [ fields ]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "openssl_asymmetric_provider.h"
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The key of every field parsed again, and released, which the provider used to leak. Both return the length of the
+   output, or -1 as RSA does. */
+static int
+parse_and_encrypt(const uint8_t *input, size_t input_len, uint8_t *output)
+{
+    BIO *bio = BIO_new_mem_buf((void *) common_rsa_public_key, -1);
+    RSA *key = PEM_read_bio_RSA_PUBKEY(bio, NULL, NULL, NULL);
+    int len;
+
+    BIO_free(bio);
+    len = RSA_public_encrypt(input_len, input, output, key, RSA_PKCS1_OAEP_PADDING);
+    RSA_free(key);
+    return len;
+}
+
+static int
+parse_and_decrypt(const uint8_t *input, size_t input_len, uint8_t *output)
+{
+    BIO *bio = BIO_new_mem_buf((void *) common_rsa_private_key, -1);
+    RSA *key = PEM_read_bio_RSAPrivateKey(bio, NULL, NULL, NULL);
+    int len;
+
+    BIO_free(bio);
+    len = RSA_private_decrypt(input_len, input, output, key, RSA_PKCS1_OAEP_PADDING);
+    RSA_free(key);
+    return len;
+}
+
+static void
+check_len(int len, const char *what)
+{
+    if (len < 0) {
+        fprintf(stderr, "Failed to %s\n", what);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void
+report(const char *what, size_t size, int fields, double seconds)
+{
+    printf("%-6zu %-28s %10.0f fields/s\n", size, what, fields / seconds);
+}
+
+/* RSA_size() of the 2048 bit key, less the 42 bytes of OAEP padding with SHA-1 */
+#define RSA_OAEP_BLOCK 214
+
+/* The encrypted blocks of a document. The RSA provider encrypts the fields in blocks of RSA_OAEP_BLOCK bytes, and the
+   envelope provider encrypts every field at once. */
+typedef struct {
+    size_t nblocks;
+    uint8_t *cipher[512];
+    size_t cipher_len[512];
+    uint8_t *iv[512];
+    size_t iv_len[512];
+} bench_document;
+
+static void
+check(lcb_error_t err, const char *what)
+{
+    if (err != LCB_SUCCESS) {
+        fprintf(stderr, "Failed to %s\n", what);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void
+encrypt_document(lcbcrypto_PROVIDER *provider, size_t block, const uint8_t *field, size_t field_len, size_t nfields,
+        bench_document *doc)
+{
+    size_t ii, jj, len;
+
+    if (provider->v.v1.generate_iv) {
+        oap_envelope_next_document(provider);
+    }
+    doc->nblocks = 0;
+    for (ii = 0; ii < nfields; ii++) {
+        for (jj = 0; jj < field_len; jj += len) {
+            size_t nn = doc->nblocks++;
+            len = field_len - jj < block ? field_len - jj : block;
+            doc->iv[nn] = NULL;
+            doc->iv_len[nn] = 0;
+            if (provider->v.v1.generate_iv) {
+                check(provider->v.v1.generate_iv(provider, &doc->iv[nn], &doc->iv_len[nn]), "generate IV");
+            }
+            check(provider->v.v1.encrypt(provider, field + jj, len, doc->iv[nn], doc->iv_len[nn], &doc->cipher[nn],
+                    &doc->cipher_len[nn]), "encrypt");
+        }
+    }
+}
+
+static void
+decrypt_document(lcbcrypto_PROVIDER *provider, bench_document *doc, size_t plain_len)
+{
+    size_t ii, len = 0, out_len;
+    uint8_t *out;
+
+    for (ii = 0; ii < doc->nblocks; ii++) {
+        check(provider->v.v1.decrypt(provider, doc->cipher[ii], doc->cipher_len[ii], doc->iv[ii], doc->iv_len[ii],
+                &out, &out_len), "decrypt");
+        len += out_len;
+        provider->v.v1.release_bytes(provider, out);
+    }
+    if (len != plain_len) {
+        fprintf(stderr, "Decrypted %zu bytes instead of %zu\n", len, plain_len);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void
+free_document(lcbcrypto_PROVIDER *provider, bench_document *doc)
+{
+    size_t ii;
+
+    for (ii = 0; ii < doc->nblocks; ii++) {
+        provider->v.v1.release_bytes(provider, doc->cipher[ii]);
+        if (doc->iv[ii]) {
+            provider->v.v1.release_bytes(provider, doc->iv[ii]);
+        }
+    }
+}
+
+static void
+bench_documents(const char *what, lcbcrypto_PROVIDER *provider, size_t block, const uint8_t *field, size_t field_len,
+        size_t nfields, int documents)
+{
+    static bench_document docs[2];
+    double start;
+    int ii;
+
+    start = now();
+    for (ii = 0; ii < documents; ii++) {
+        encrypt_document(provider, block, field, field_len, nfields, &docs[0]);
+        free_document(provider, &docs[0]);
+    }
+    /* the envelope provider wraps a single key for the document */
+    printf("%2zu x %-6zu %-28s %10.0f documents/s %4zu RSA operations\n", nfields, field_len, what,
+           documents / (now() - start), provider->v.v1.generate_iv ? 1 : docs[0].nblocks);
+
+    /* two documents in turn, so that the envelope has to unwrap the key of every one */
+    encrypt_document(provider, block, field, field_len, nfields, &docs[0]);
+    encrypt_document(provider, block, field, field_len, nfields, &docs[1]);
+    start = now();
+    for (ii = 0; ii < documents / 10; ii++) {
+        decrypt_document(provider, &docs[ii % 2], field_len * nfields);
+    }
+    printf("%2zu x %-6zu %-28s %10.0f documents/s\n", nfields, field_len, "  decrypt", documents / 10 / (now() - start));
+    free_document(provider, &docs[0]);
+    free_document(provider, &docs[1]);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const size_t sizes[] = {16, 128};
+    lcbcrypto_PROVIDER *provider, *envelope;
+    uint8_t input[128], cipher[512], plain[512], *output, *large;
+    size_t output_len, s;
+    int i, cipher_len = 0, fields = 2000;
+    double start;
+
+    if (argc > 1) {
+        fields = atoi(argv[1]);
+    }
+    oap_initialize();
+    provider = oap_create();
+    memset(input, 'x', sizeof(input));
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        start = now();
+        for (i = 0; i < fields; i++) {
+            cipher_len = parse_and_encrypt(input, sizes[s], cipher);
+            check_len(cipher_len, "encrypt");
+        }
+        report("encrypt, parsing the key", sizes[s], fields, now() - start);
+
+        start = now();
+        for (i = 0; i < fields; i++) {
+            if (provider->v.v1.encrypt(provider, input, sizes[s], NULL, 0, &output, &output_len) != LCB_SUCCESS) {
+                fprintf(stderr, "Failed to encrypt\n");
+                return EXIT_FAILURE;
+            }
+            provider->v.v1.release_bytes(provider, output);
+        }
+        report("encrypt, cached key", sizes[s], fields, now() - start);
+
+        start = now();
+        for (i = 0; i < fields / 10; i++) {
+            check_len(parse_and_decrypt(cipher, cipher_len, plain), "decrypt");
+        }
+        report("decrypt, parsing the key", sizes[s], fields / 10, now() - start);
+
+        start = now();
+        for (i = 0; i < fields / 10; i++) {
+            if (provider->v.v1.decrypt(provider, cipher, cipher_len, NULL, 0, &output, &output_len) != LCB_SUCCESS ||
+                output_len != sizes[s] || memcmp(output, input, output_len) != 0) {
+                fprintf(stderr, "Failed to decrypt\n");
+                return EXIT_FAILURE;
+            }
+            provider->v.v1.release_bytes(provider, output);
+        }
+        report("decrypt, cached key", sizes[s], fields / 10, now() - start);
+    }
+
+    /* a document of small fields, and one with a large field */
+    envelope = oap_envelope_create();
+    large = malloc(65536);
+    memset(large, 'x', 65536);
+    printf("\n");
+    bench_documents("RSA for every field", provider, RSA_OAEP_BLOCK, input, sizeof(input), 10, fields / 10);
+    bench_documents("envelope", envelope, sizeof(input), input, sizeof(input), 10, fields / 10);
+    bench_documents("RSA for every block", provider, RSA_OAEP_BLOCK, large, 65536, 1, fields / 100 + 10);
+    bench_documents("envelope", envelope, 65536, large, 65536, 1, fields / 100 + 10);
+
+    free(large);
+    envelope->destructor(envelope);
+    provider->destructor(provider);
+    return EXIT_SUCCESS;
+}
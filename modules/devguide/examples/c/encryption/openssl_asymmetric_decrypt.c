@@ -44,7 +44,7 @@ op_callback(lcb_INSTANCE instance, int cbtype, const lcb_RESPBASE *rb)
     if (rb->rc == LCB_SUCCESS) {
         const lcb_RESPGET *rg = (const lcb_RESPGET *) rb;
         lcbcrypto_CMDDECRYPT dcmd = {};
-        lcbcrypto_FIELDSPEC field = {};
+        lcbcrypto_FIELDSPEC fields[2] = {};
         lcb_error_t err;
 
         printf("VALUE:  %.*s\n", (int) rg->nvalue, rg->value);
@@ -54,10 +54,14 @@ op_callback(lcb_INSTANCE instance, int cbtype, const lcb_RESPBASE *rb)
         dcmd.ndoc = rg->nvalue;
         dcmd.out = NULL;
         dcmd.nout = 0;
-        dcmd.nfields = 1;
-        dcmd.fields = &field;
-        field.name = "message";
-        field.alg = "RSA-2048-OAEP-SHA1";
+        /* the field is decrypted by the algorithm named in the document, and the other one is skipped, so that the
+           documents written before the envelope can still be read */
+        dcmd.nfields = 2;
+        dcmd.fields = fields;
+        fields[0].name = "message";
+        fields[0].alg = "RSA-2048-OAEP-AES-256-GCM";
+        fields[1].name = "message";
+        fields[1].alg = "RSA-2048-OAEP-SHA1";
         err = lcbcrypto_decrypt_fields(instance, &dcmd);
         if (err != LCB_SUCCESS) {
             die(instance, "Couldn't decrypt field 'message'", err);
@@ -126,6 +130,7 @@ main(int argc, char *argv[])
         lcb_install_callback3(instance, LCB_CALLBACK_GET, op_callback);
     }
 
+    lcbcrypto_register(instance, "RSA-2048-OAEP-AES-256-GCM", oap_envelope_create());
     lcbcrypto_register(instance, "RSA-2048-OAEP-SHA1", oap_create());
 
     get_encrypted(instance, "secret-1");
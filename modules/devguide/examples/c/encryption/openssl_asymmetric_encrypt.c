@@ -51,7 +51,7 @@ op_callback(lcb_INSTANCE instance, int cbtype, const lcb_RESPBASE *rb)
 }
 
 static void
-store_encrypted(lcb_INSTANCE instance, const char *key, const char *val)
+store_encrypted(lcb_INSTANCE instance, lcbcrypto_PROVIDER *provider, const char *key, const char *val)
 {
     lcb_error_t err;
     lcb_CMDSTORE cmd = {};
@@ -70,8 +70,10 @@ store_encrypted(lcb_INSTANCE instance, const char *key, const char *val)
     ecmd.nfields = 1;
     ecmd.fields = &field;
     field.name = "message";
-    field.alg = "RSA-2048-OAEP-SHA1";
+    /* the fields are encrypted with a data key of their own document, and only the data key with RSA */
+    field.alg = "RSA-2048-OAEP-AES-256-GCM";
 
+    oap_envelope_next_document(provider);
     err = lcbcrypto_encrypt_fields(instance, &ecmd);
     if (err != LCB_SUCCESS) {
         die(instance, "Couldn't encrypt field 'message'", err);
@@ -100,6 +102,7 @@ main(int argc, char *argv[])
 {
     lcb_error_t err;
     lcb_INSTANCE instance;
+    lcbcrypto_PROVIDER *provider;
 
     {
         struct lcb_create_st create_options = {};
@@ -128,20 +131,21 @@ main(int argc, char *argv[])
         lcb_install_callback3(instance, LCB_CALLBACK_STORE, op_callback);
     }
 
-    lcbcrypto_register(instance, "RSA-2048-OAEP-SHA1", oap_create());
+    provider = oap_envelope_create();
+    lcbcrypto_register(instance, "RSA-2048-OAEP-AES-256-GCM", provider);
 
-    store_encrypted(instance, "secret-1",
+    store_encrypted(instance, provider, "secret-1",
             "{\"message\":\"The old grey goose jumped over the wrickety gate.\"}");
     printf("\n");
-    store_encrypted(instance, "secret-2", "{\"message\":10}");
+    store_encrypted(instance, provider, "secret-2", "{\"message\":10}");
     printf("\n");
-    store_encrypted(instance, "secret-3", "{\"message\":\"10\"}");
+    store_encrypted(instance, provider, "secret-3", "{\"message\":\"10\"}");
     printf("\n");
-    store_encrypted(instance,
+    store_encrypted(instance, provider,
             "secret-4",
             "{\"message\":[\"The\",\"Old\",\"Grey\",\"Goose\",\"Jumped\",\"over\",\"the\",\"wrickety\",\"gate\"]}");
     printf("\n");
-    store_encrypted(instance, "secret-5",
+    store_encrypted(instance, provider, "secret-5",
             "{\"message\":{\"myValue\":\"The old grey goose jumped over the wrickety gate.\",\"myInt\":10}}");
 
     lcb_destroy(instance);
@@ -29,10 +29,49 @@
 #include <openssl/conf.h>
 #include <openssl/evp.h>
 #include <openssl/err.h>
+#include <openssl/rand.h>
+
+/* The keys are parsed once, when the provider is created, and kept in its cookie. */
+typedef struct {
+    RSA *public_key;
+    RSA *private_key;
+} oap_keys;
+
+/* A key which fails to parse is reported here, and fails every call which needs it. */
+static void
+oap_read_keys(oap_keys *keys)
+{
+    BIO *bio;
+
+    bio = BIO_new_mem_buf((void *) common_rsa_public_key, -1);
+    keys->public_key = PEM_read_bio_RSA_PUBKEY(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+    if (!keys->public_key) {
+        fprintf(stderr, "Failed to read public key: %s\n", ERR_error_string(ERR_get_error(), NULL));
+    }
+    bio = BIO_new_mem_buf((void *) common_rsa_private_key, -1);
+    keys->private_key = PEM_read_bio_RSAPrivateKey(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+    if (!keys->private_key) {
+        fprintf(stderr, "Failed to read private key: %s\n", ERR_error_string(ERR_get_error(), NULL));
+    }
+}
+
+static void
+oap_free_keys(oap_keys *keys)
+{
+    RSA_free(keys->public_key);
+    RSA_free(keys->private_key);
+}
 
 static void
 oap_free(lcbcrypto_PROVIDER *provider)
 {
+    oap_keys *keys = provider->cookie;
+    if (keys) {
+        oap_free_keys(keys);
+        free(keys);
+    }
     free(provider);
 }
 
@@ -53,20 +92,25 @@ static lcb_error_t
 oap_encrypt(struct lcbcrypto_PROVIDER *provider, const uint8_t *input, size_t input_len,
         const uint8_t *iv, size_t iv_len, uint8_t **output, size_t *output_len)
 {
-    BIO *bio = BIO_new_mem_buf((void *) common_rsa_public_key, -1);
-    RSA *rsa_pub_key = PEM_read_bio_RSA_PUBKEY(bio, NULL, NULL, NULL);
-    BIO_free(bio);
+    RSA *rsa_pub_key = ((oap_keys *) provider->cookie)->public_key;
+    int len;
+
     if (!rsa_pub_key) {
-        fprintf(stderr, "Failed to read public key: %s\n", ERR_error_string(ERR_get_error(), NULL));
         return LCB_EINVAL;
     }
     /**
      * For simplicity this providers operates with data which is no more than RSA_size().
-     * In production application, the data have to be processed in blocks
+     * Larger fields are better served by the envelope provider below, than processed in blocks
      */
     *output = malloc(RSA_size(rsa_pub_key));
-    *output_len = RSA_public_encrypt(input_len, input, *output, rsa_pub_key,
-            RSA_PKCS1_OAEP_PADDING);
+    len = RSA_public_encrypt(input_len, input, *output, rsa_pub_key, RSA_PKCS1_OAEP_PADDING);
+    if (len < 0) {
+        fprintf(stderr, "Failed to encrypt: %s\n", ERR_error_string(ERR_get_error(), NULL));
+        free(*output);
+        *output = NULL;
+        return LCB_EINVAL;
+    }
+    *output_len = len;
     return LCB_SUCCESS;
 }
 
@@ -74,21 +118,25 @@ static lcb_error_t
 oap_decrypt(struct lcbcrypto_PROVIDER *provider, const uint8_t *input, size_t input_len,
         const uint8_t *iv, size_t iv_len, uint8_t **output, size_t *output_len)
 {
-    BIO *bio = BIO_new_mem_buf((void *) common_rsa_private_key, -1);
-    RSA *rsa_priv_key = PEM_read_bio_RSAPrivateKey(bio, NULL, NULL, NULL);
-    BIO_free(bio);
+    RSA *rsa_priv_key = ((oap_keys *) provider->cookie)->private_key;
+    int len;
+
     if (!rsa_priv_key) {
-        fprintf(stderr, "Failed to read private key: %s\n",
-                ERR_error_string(ERR_get_error(), NULL));
         return LCB_EINVAL;
     }
     /**
      * For simplicity this providers operates with data which is no more than RSA_size().
-     * In production application, the data have to be processed in blocks
+     * Larger fields are better served by the envelope provider below, than processed in blocks
      */
     *output = malloc(RSA_size(rsa_priv_key));
-    *output_len = RSA_private_decrypt(input_len, input, *output, rsa_priv_key,
-            RSA_PKCS1_OAEP_PADDING);
+    len = RSA_private_decrypt(input_len, input, *output, rsa_priv_key, RSA_PKCS1_OAEP_PADDING);
+    if (len < 0) {
+        fprintf(stderr, "Failed to decrypt: %s\n", ERR_error_string(ERR_get_error(), NULL));
+        free(*output);
+        *output = NULL;
+        return LCB_EINVAL;
+    }
+    *output_len = len;
     return LCB_SUCCESS;
 }
 
@@ -96,7 +144,12 @@ lcbcrypto_PROVIDER *
 oap_create()
 {
     lcbcrypto_PROVIDER *provider = calloc(1, sizeof(lcbcrypto_PROVIDER));
+    oap_keys *keys = calloc(1, sizeof(oap_keys));
+
+    oap_read_keys(keys);
+
     provider->version = 1;
+    provider->cookie = keys;
     provider->destructor = oap_free;
     provider->v.v1.release_bytes = oap_release_bytes;
     provider->v.v1.encrypt = oap_encrypt;
@@ -105,10 +158,166 @@ oap_create()
     return provider;
 }
 
+/**
+ * The envelope provider encrypts the fields of a document with AES-256-GCM, under a random data key generated for the
+ * document, and only wraps the data key with RSA. Every field carries the wrapped key in front of its ciphertext, so
+ * that it can still be decrypted on its own:
+ *
+ *     wrapped data key (RSA_size) | ciphertext | GCM tag
+ *
+ * The provider remembers the last key it unwrapped, so that a document costs one RSA operation to encrypt and one to
+ * decrypt, whatever the number and size of its fields. Documents are encrypted one at a time, so the provider is meant
+ * for one thread.
+ */
+typedef struct {
+    oap_keys keys;
+    EVP_CIPHER_CTX *encrypt;
+    EVP_CIPHER_CTX *decrypt;
+    int wrapped;  /* the data key of the current document is generated and wrapped */
+    uint8_t data_key[AES256_KEY_SIZE];
+    uint8_t *wrapped_key;
+    int unwrapped;  /* the last key unwrapped, and the wrapped key it came from */
+    uint8_t unwrapped_key[AES256_KEY_SIZE];
+    uint8_t *unwrapped_from;
+} oap_envelope;
+
+static void
+oap_envelope_free(lcbcrypto_PROVIDER *provider)
+{
+    oap_envelope *envelope = provider->cookie;
+
+    OPENSSL_cleanse(envelope->data_key, AES256_KEY_SIZE);
+    OPENSSL_cleanse(envelope->unwrapped_key, AES256_KEY_SIZE);
+    oap_free_keys(&envelope->keys);
+    EVP_CIPHER_CTX_free(envelope->encrypt);
+    EVP_CIPHER_CTX_free(envelope->decrypt);
+    free(envelope->wrapped_key);
+    free(envelope->unwrapped_from);
+    free(envelope);
+    free(provider);
+}
+
+static lcb_error_t
+oap_envelope_generate_iv(struct lcbcrypto_PROVIDER *provider, uint8_t **iv, size_t *iv_len)
+{
+    (void) provider;
+    return common_gcm_generate_iv(iv, iv_len);
+}
+
+static lcb_error_t
+oap_envelope_encrypt(struct lcbcrypto_PROVIDER *provider, const uint8_t *input, size_t input_len,
+        const uint8_t *iv, size_t iv_len, uint8_t **output, size_t *output_len)
+{
+    oap_envelope *envelope = provider->cookie;
+    RSA *rsa_pub_key = envelope->keys.public_key;
+
+    if (!rsa_pub_key || !envelope->encrypt) {
+        return LCB_EINVAL;
+    }
+    /* the first field of the document pays for the data key */
+    if (!envelope->wrapped) {
+        if (RAND_bytes(envelope->data_key, AES256_KEY_SIZE) != 1 ||
+            RSA_public_encrypt(AES256_KEY_SIZE, envelope->data_key, envelope->wrapped_key, rsa_pub_key,
+                    RSA_PKCS1_OAEP_PADDING) < 0) {
+            fprintf(stderr, "Failed to wrap data key: %s\n", ERR_error_string(ERR_get_error(), NULL));
+            return LCB_EINVAL;
+        }
+        envelope->wrapped = 1;
+    }
+    return common_gcm_seal(envelope->encrypt, envelope->data_key, iv, iv_len, envelope->wrapped_key,
+            RSA_size(rsa_pub_key), input, input_len, output, output_len);
+}
+
+static lcb_error_t
+oap_envelope_decrypt(struct lcbcrypto_PROVIDER *provider, const uint8_t *input, size_t input_len,
+        const uint8_t *iv, size_t iv_len, uint8_t **output, size_t *output_len)
+{
+    oap_envelope *envelope = provider->cookie;
+    RSA *rsa_priv_key = envelope->keys.private_key;
+    size_t wrapped_len;
+    uint8_t *key;
+    int len;
+
+    if (!rsa_priv_key || !envelope->decrypt) {
+        return LCB_EINVAL;
+    }
+    wrapped_len = RSA_size(rsa_priv_key);
+    if (input_len < wrapped_len) {
+        return LCB_EINVAL;
+    }
+
+    /* the other fields of the document reuse the key unwrapped for the first one */
+    if (!envelope->unwrapped || memcmp(envelope->unwrapped_from, input, wrapped_len) != 0) {
+        envelope->unwrapped = 0;
+        key = malloc(wrapped_len);
+        len = RSA_private_decrypt(wrapped_len, input, key, rsa_priv_key, RSA_PKCS1_OAEP_PADDING);
+        if (len != AES256_KEY_SIZE) {
+            fprintf(stderr, "Failed to unwrap data key: %s\n", ERR_error_string(ERR_get_error(), NULL));
+            OPENSSL_cleanse(key, wrapped_len);
+            free(key);
+            return LCB_EINVAL;
+        }
+        memcpy(envelope->unwrapped_key, key, AES256_KEY_SIZE);
+        memcpy(envelope->unwrapped_from, input, wrapped_len);
+        envelope->unwrapped = 1;
+        OPENSSL_cleanse(key, wrapped_len);
+        free(key);
+    }
+    return common_gcm_open(envelope->decrypt, envelope->unwrapped_key, iv, iv_len, input + wrapped_len,
+            input_len - wrapped_len, output, output_len);
+}
+
+void
+oap_envelope_next_document(lcbcrypto_PROVIDER *provider)
+{
+    oap_envelope *envelope = provider->cookie;
+
+    OPENSSL_cleanse(envelope->data_key, AES256_KEY_SIZE);
+    envelope->wrapped = 0;
+}
+
+lcbcrypto_PROVIDER *
+oap_envelope_create()
+{
+    lcbcrypto_PROVIDER *provider = calloc(1, sizeof(lcbcrypto_PROVIDER));
+    oap_envelope *envelope = calloc(1, sizeof(oap_envelope));
+
+    oap_read_keys(&envelope->keys);
+    if (envelope->keys.public_key) {
+        envelope->wrapped_key = malloc(RSA_size(envelope->keys.public_key));
+    }
+    if (envelope->keys.private_key) {
+        envelope->unwrapped_from = malloc(RSA_size(envelope->keys.private_key));
+    }
+    /* keyed for every field, with the data key of its document */
+    envelope->encrypt = EVP_CIPHER_CTX_new();
+    envelope->decrypt = EVP_CIPHER_CTX_new();
+    if (!envelope->encrypt || !envelope->decrypt ||
+        EVP_EncryptInit_ex(envelope->encrypt, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1 ||
+        EVP_DecryptInit_ex(envelope->decrypt, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1) {
+        fprintf(stderr, "Failed to create cipher contexts: %s\n", ERR_error_string(ERR_get_error(), NULL));
+        EVP_CIPHER_CTX_free(envelope->encrypt);
+        EVP_CIPHER_CTX_free(envelope->decrypt);
+        envelope->encrypt = NULL;
+        envelope->decrypt = NULL;
+    }
+
+    provider->version = 1;
+    provider->cookie = envelope;
+    provider->destructor = oap_envelope_free;
+    provider->v.v1.release_bytes = oap_release_bytes;
+    provider->v.v1.generate_iv = oap_envelope_generate_iv;
+    provider->v.v1.encrypt = oap_envelope_encrypt;
+    provider->v.v1.decrypt = oap_envelope_decrypt;
+    provider->v.v1.get_key_id = oap_get_key_id;
+    return provider;
+}
+
 void
 oap_initialize()
 {
     SSL_library_init();
     SSL_load_error_strings();
     EVP_add_cipher(EVP_aes_256_cbc());
+    EVP_add_cipher(EVP_aes_256_gcm());
 }
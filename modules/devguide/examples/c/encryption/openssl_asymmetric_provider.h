@@ -29,4 +29,13 @@ oap_initialize();
 lcbcrypto_PROVIDER *
 oap_create();
 
+/* RSA envelope encryption: the fields of a document are encrypted with AES-256-GCM under a random data key, and only
+   the data key is encrypted with RSA, so the fields are not limited to RSA_size(). */
+lcbcrypto_PROVIDER *
+oap_envelope_create();
+
+/* Called before the fields of every document are encrypted, to give it a new data key. */
+void
+oap_envelope_next_document(lcbcrypto_PROVIDER *provider);
+
 #endif
@@ -0,0 +1,166 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * This is an example of using crypto API of libcouchbase. The implementation should not be considered as production
+ * ready, because it uses hardcoded keys, insecure memory allocation, copying and comparison. Consult documentation of
+ * your crypto library on how to properly work with keys and buffers.
+ *
+ * AES-256-GCM encrypts and authenticates the field in a single pass, so unlike AES-256-HMAC-SHA256 the provider has no
+ * signature functions: the tag is appended to the ciphertext, and checked when it is decrypted.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "openssl_gcm_provider.h"
+
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include <openssl/err.h>
+
+/* Every thread gets its own contexts, keyed when it first uses them, and a field only sets the IV. */
+typedef struct {
+    EVP_CIPHER_CTX *encrypt;
+    EVP_CIPHER_CTX *decrypt;
+} ogp_contexts;
+
+typedef struct {
+    pthread_key_t contexts;
+} ogp_state;
+
+static void
+ogp_free_contexts(void *data)
+{
+    ogp_contexts *contexts = data;
+    EVP_CIPHER_CTX_free(contexts->encrypt);
+    EVP_CIPHER_CTX_free(contexts->decrypt);
+    free(contexts);
+}
+
+static ogp_contexts *
+ogp_get_contexts(lcbcrypto_PROVIDER *provider)
+{
+    ogp_state *state = provider->cookie;
+    ogp_contexts *contexts = pthread_getspecific(state->contexts);
+
+    if (contexts) {
+        return contexts;
+    }
+    contexts = calloc(1, sizeof(ogp_contexts));
+    contexts->encrypt = EVP_CIPHER_CTX_new();
+    contexts->decrypt = EVP_CIPHER_CTX_new();
+    if (!contexts->encrypt || !contexts->decrypt ||
+        EVP_EncryptInit_ex(contexts->encrypt, EVP_aes_256_gcm(), NULL, common_aes256_key, NULL) != 1 ||
+        EVP_DecryptInit_ex(contexts->decrypt, EVP_aes_256_gcm(), NULL, common_aes256_key, NULL) != 1 ||
+        pthread_setspecific(state->contexts, contexts) != 0) {
+        ogp_free_contexts(contexts);
+        return NULL;
+    }
+    return contexts;
+}
+
+/* The contexts of the other threads are released when they exit, so they should be done with the provider before it
+   is destroyed. */
+static void
+ogp_free(lcbcrypto_PROVIDER *provider)
+{
+    ogp_state *state = provider->cookie;
+    ogp_contexts *contexts = pthread_getspecific(state->contexts);
+
+    if (contexts) {
+        ogp_free_contexts(contexts);
+    }
+    pthread_key_delete(state->contexts);
+    free(state);
+    free(provider);
+}
+
+static void
+ogp_release_bytes(lcbcrypto_PROVIDER *provider, void *bytes)
+{
+    free(bytes);
+    (void) provider;
+}
+
+static const char *
+ogp_get_key_id(lcbcrypto_PROVIDER *provider)
+{
+    return common_aes256_key_id;
+}
+
+/* GCM loses both confidentiality and integrity when an IV is reused with the same key, so unlike the fixed IV of the
+   CBC example, it has to be random for every field. */
+static lcb_error_t
+ogp_generate_iv(struct lcbcrypto_PROVIDER *provider, uint8_t **iv, size_t *iv_len)
+{
+    (void) provider;
+    return common_gcm_generate_iv(iv, iv_len);
+}
+
+static lcb_error_t
+ogp_encrypt(struct lcbcrypto_PROVIDER *provider, const uint8_t *input, size_t input_len,
+        const uint8_t *iv, size_t iv_len, uint8_t **output, size_t *output_len)
+{
+    ogp_contexts *contexts = ogp_get_contexts(provider);
+
+    if (!contexts) {
+        return LCB_EINVAL;
+    }
+    /* the context keeps its key, and only takes the new IV */
+    return common_gcm_seal(contexts->encrypt, NULL, iv, iv_len, NULL, 0, input, input_len, output, output_len);
+}
+
+static lcb_error_t
+ogp_decrypt(struct lcbcrypto_PROVIDER *provider, const uint8_t *input, size_t input_len,
+        const uint8_t *iv, size_t iv_len, uint8_t **output, size_t *output_len)
+{
+    ogp_contexts *contexts = ogp_get_contexts(provider);
+
+    if (!contexts) {
+        return LCB_EINVAL;
+    }
+    return common_gcm_open(contexts->decrypt, NULL, iv, iv_len, input, input_len, output, output_len);
+}
+
+lcbcrypto_PROVIDER *
+ogp_create()
+{
+    lcbcrypto_PROVIDER *provider = calloc(1, sizeof(lcbcrypto_PROVIDER));
+    ogp_state *state = calloc(1, sizeof(ogp_state));
+
+    pthread_key_create(&state->contexts, ogp_free_contexts);
+
+    provider->version = 1;
+    provider->cookie = state;
+    provider->destructor = ogp_free;
+    provider->v.v1.release_bytes = ogp_release_bytes;
+    provider->v.v1.generate_iv = ogp_generate_iv;
+    provider->v.v1.encrypt = ogp_encrypt;
+    provider->v.v1.decrypt = ogp_decrypt;
+    provider->v.v1.get_key_id = ogp_get_key_id;
+    return provider;
+}
+
+void
+ogp_initialize()
+{
+    SSL_library_init();
+    SSL_load_error_strings();
+    EVP_add_cipher(EVP_aes_256_gcm());
+}
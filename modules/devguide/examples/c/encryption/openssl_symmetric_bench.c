@@ -0,0 +1,149 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * Throughput of the symmetric algorithms on fields of 64 B, 1 KiB and 64 KiB: AES-256-HMAC-SHA256, which encrypts in
+ * CBC mode and signs the ciphertext in a second pass, against AES-256-GCM, which does both in one. Every field goes
+ * through the provider calls libcouchbase makes for it, and the bench does not need a cluster:
+ *
+ *     $ make openssl_symmetric_bench
+ *     $ ./openssl_symmetric_bench [ megabytes ]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "openssl_symmetric_provider.h"
+#include "openssl_gcm_provider.h"
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *alg, const char *what, size_t size, size_t fields, double seconds)
+{
+    printf("%-8zu %-20s %-8s %10.1f MB/s %10.0f fields/s\n", size, alg, what,
+           size * fields / seconds / (1024 * 1024), fields / seconds);
+}
+
+static void
+check(lcb_error_t err, const char *what)
+{
+    if (err != LCB_SUCCESS) {
+        fprintf(stderr, "Failed to %s\n", what);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void
+bench(const char *alg, lcbcrypto_PROVIDER *provider, const uint8_t *data, size_t size, size_t fields)
+{
+    uint8_t *iv, *cipher, *sig = NULL, *plain;
+    size_t ii, iv_len, cipher_len, sig_len = 0, plain_len;
+    lcbcrypto_SIGV sigv[2];
+    double start;
+
+    start = now();
+    for (ii = 0; ii < fields; ii++) {
+        check(provider->v.v1.generate_iv(provider, &iv, &iv_len), "generate IV");
+        check(provider->v.v1.encrypt(provider, data, size, iv, iv_len, &cipher, &cipher_len), "encrypt");
+        if (provider->v.v1.sign) {
+            sigv[0].data = iv;
+            sigv[0].len = iv_len;
+            sigv[1].data = cipher;
+            sigv[1].len = cipher_len;
+            check(provider->v.v1.sign(provider, sigv, 2, &sig, &sig_len), "sign");
+            provider->v.v1.release_bytes(provider, sig);
+        }
+        provider->v.v1.release_bytes(provider, cipher);
+        provider->v.v1.release_bytes(provider, iv);
+    }
+    report(alg, "encrypt", size, fields, now() - start);
+
+    /* one field, decrypted over and over */
+    check(provider->v.v1.generate_iv(provider, &iv, &iv_len), "generate IV");
+    check(provider->v.v1.encrypt(provider, data, size, iv, iv_len, &cipher, &cipher_len), "encrypt");
+    sigv[0].data = iv;
+    sigv[0].len = iv_len;
+    sigv[1].data = cipher;
+    sigv[1].len = cipher_len;
+    if (provider->v.v1.sign) {
+        check(provider->v.v1.sign(provider, sigv, 2, &sig, &sig_len), "sign");
+    }
+
+    start = now();
+    for (ii = 0; ii < fields; ii++) {
+        if (provider->v.v1.verify_signature) {
+            check(provider->v.v1.verify_signature(provider, sigv, 2, sig, sig_len), "verify signature");
+        }
+        check(provider->v.v1.decrypt(provider, cipher, cipher_len, iv, iv_len, &plain, &plain_len), "decrypt");
+        if (plain_len != size || memcmp(plain, data, size) != 0) {
+            fprintf(stderr, "Decrypted %zu bytes do not match\n", size);
+            exit(EXIT_FAILURE);
+        }
+        provider->v.v1.release_bytes(provider, plain);
+    }
+    report(alg, "decrypt", size, fields, now() - start);
+
+    if (sig) {
+        provider->v.v1.release_bytes(provider, sig);
+    }
+    provider->v.v1.release_bytes(provider, cipher);
+    provider->v.v1.release_bytes(provider, iv);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const size_t sizes[] = {64, 1024, 65536};
+    lcbcrypto_PROVIDER *hmac, *gcm;
+    size_t ii, total = 256 * 1024 * 1024;
+    uint8_t *data = malloc(sizes[2]);
+
+    if (argc > 1) {
+        total = (size_t) atoi(argv[1]) * 1024 * 1024;
+    }
+    for (ii = 0; ii < sizes[2]; ii++) {
+        data[ii] = (uint8_t) (ii * 31 + 7);
+    }
+    osp_initialize();
+    ogp_initialize();
+    hmac = osp_create();
+    gcm = ogp_create();
+
+    printf("%-8s %-20s %-8s %15s %19s\n", "bytes", "algorithm", "op", "throughput", "rate");
+    for (ii = 0; ii < sizeof(sizes) / sizeof(sizes[0]); ii++) {
+        /* the small fields are dominated by the calls, and do not need as many bytes */
+        size_t fields = (ii == 0 ? total / 16 : total) / sizes[ii] + 1;
+        bench("AES-256-HMAC-SHA256", hmac, data, sizes[ii], fields);
+        bench("AES-256-GCM", gcm, data, sizes[ii], fields);
+    }
+
+    hmac->destructor(hmac);
+    gcm->destructor(gcm);
+    free(data);
+    return EXIT_SUCCESS;
+}
@@ -30,6 +30,7 @@
 #endif
 
 #include "openssl_symmetric_provider.h"
+#include "openssl_gcm_provider.h"
 
 static void
 die(lcb_INSTANCE instance, const char *msg, lcb_error_t err)
@@ -44,7 +45,7 @@ op_callback(lcb_INSTANCE instance, int cbtype, const lcb_RESPBASE *rb)
     if (rb->rc == LCB_SUCCESS) {
         const lcb_RESPGET *rg = (const lcb_RESPGET *) rb;
         lcbcrypto_CMDDECRYPT dcmd = {};
-        lcbcrypto_FIELDSPEC field = {};
+        lcbcrypto_FIELDSPEC fields[2] = {};
         lcb_error_t err;
 
         printf("VALUE:  %.*s\n", (int) rg->nvalue, rg->value);
@@ -54,10 +55,14 @@ op_callback(lcb_INSTANCE instance, int cbtype, const lcb_RESPBASE *rb)
         dcmd.ndoc = rg->nvalue;
         dcmd.out = NULL;
         dcmd.nout = 0;
-        dcmd.nfields = 1;
-        dcmd.fields = &field;
-        field.name = "message";
-        field.alg = "AES-256-HMAC-SHA256";
+        /* the field is decrypted by the algorithm named in the document, and the other one is skipped, so that the
+           documents written before AES-256-GCM can still be read */
+        dcmd.nfields = 2;
+        dcmd.fields = fields;
+        fields[0].name = "message";
+        fields[0].alg = "AES-256-GCM";
+        fields[1].name = "message";
+        fields[1].alg = "AES-256-HMAC-SHA256";
         err = lcbcrypto_decrypt_fields(instance, &dcmd);
         if (err != LCB_SUCCESS) {
             die(instance, "Couldn't decrypt field 'message'", err);
@@ -126,6 +131,7 @@ main(int argc, char *argv[])
         lcb_install_callback3(instance, LCB_CALLBACK_GET, op_callback);
     }
 
+    lcbcrypto_register(instance, "AES-256-GCM", ogp_create());
     lcbcrypto_register(instance, "AES-256-HMAC-SHA256", osp_create());
 
     get_encrypted(instance, "secret-1");
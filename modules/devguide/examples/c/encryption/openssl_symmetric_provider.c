@@ -21,6 +21,8 @@
  * your crypto library on how to properly work with keys and buffers.
  */
 
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "openssl_symmetric_provider.h"
@@ -29,10 +31,73 @@
 #include <openssl/conf.h>
 #include <openssl/evp.h>
 #include <openssl/err.h>
+#include <openssl/crypto.h>
 
+/* The HMAC key and digest are set up once for the provider, and every thread gets its own contexts, keyed when it
+   first uses them. A field then only resets the contexts, instead of allocating and keying new ones. */
+typedef struct {
+    EVP_MD_CTX *hmac;  /* keyed once, and copied for every signature */
+    EVP_MD_CTX *md;
+    EVP_CIPHER_CTX *encrypt;
+    EVP_CIPHER_CTX *decrypt;
+} osp_contexts;
+
+typedef struct {
+    const EVP_MD *md;
+    EVP_PKEY *hmac_key;
+    pthread_key_t contexts;
+} osp_state;
+
+static void
+osp_free_contexts(void *data)
+{
+    osp_contexts *contexts = data;
+    EVP_MD_CTX_free(contexts->hmac);
+    EVP_MD_CTX_free(contexts->md);
+    EVP_CIPHER_CTX_free(contexts->encrypt);
+    EVP_CIPHER_CTX_free(contexts->decrypt);
+    free(contexts);
+}
+
+static osp_contexts *
+osp_get_contexts(lcbcrypto_PROVIDER *provider)
+{
+    osp_state *state = provider->cookie;
+    osp_contexts *contexts = pthread_getspecific(state->contexts);
+
+    if (contexts) {
+        return contexts;
+    }
+    contexts = calloc(1, sizeof(osp_contexts));
+    contexts->hmac = EVP_MD_CTX_new();
+    contexts->md = EVP_MD_CTX_new();
+    contexts->encrypt = EVP_CIPHER_CTX_new();
+    contexts->decrypt = EVP_CIPHER_CTX_new();
+    if (!contexts->hmac || !contexts->md || !contexts->encrypt || !contexts->decrypt ||
+        EVP_DigestSignInit(contexts->hmac, NULL, state->md, NULL, state->hmac_key) != 1 ||
+        EVP_EncryptInit_ex(contexts->encrypt, EVP_aes_256_cbc(), NULL, common_aes256_key, NULL) != 1 ||
+        EVP_DecryptInit_ex(contexts->decrypt, EVP_aes_256_cbc(), NULL, common_aes256_key, NULL) != 1 ||
+        pthread_setspecific(state->contexts, contexts) != 0) {
+        osp_free_contexts(contexts);
+        return NULL;
+    }
+    return contexts;
+}
+
+/* The contexts of the other threads are released when they exit, so they should be done with the provider before it
+   is destroyed. */
 static void
 osp_free(lcbcrypto_PROVIDER *provider)
 {
+    osp_state *state = provider->cookie;
+    osp_contexts *contexts = pthread_getspecific(state->contexts);
+
+    if (contexts) {
+        osp_free_contexts(contexts);
+    }
+    pthread_key_delete(state->contexts);
+    EVP_PKEY_free(state->hmac_key);
+    free(state);
     free(provider);
 }
 
@@ -60,51 +125,32 @@ osp_generate_iv(struct lcbcrypto_PROVIDER *provider, uint8_t **iv, size_t *iv_le
     return LCB_SUCCESS;
 }
 
-static lcb_error_t
-osp_sign(struct lcbcrypto_PROVIDER *provider, const lcbcrypto_SIGV *inputs, size_t inputs_num,
-        uint8_t **sig, size_t *sig_len)
+static int
+osp_hmac(lcbcrypto_PROVIDER *provider, const lcbcrypto_SIGV *inputs, size_t inputs_num, uint8_t *out,
+        size_t *out_len)
 {
-    const EVP_MD *md;
-    uint8_t out[EVP_MAX_MD_SIZE];
-    size_t out_len = EVP_MAX_MD_SIZE;
-    int rc, key_len = strlen((const char *) common_hmac_sha256_key);
-    EVP_MD_CTX *ctx = NULL;
-    EVP_PKEY *key = NULL;
+    osp_contexts *contexts = osp_get_contexts(provider);
     size_t ii;
 
-    md = EVP_get_digestbyname("SHA256");
-    if (md == NULL) {
-        return LCB_EINVAL;
-    }
-
-    key = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, NULL, common_hmac_sha256_key, key_len);
-    if (key == NULL) {
-        return LCB_EINVAL;
-    }
-
-    ctx = EVP_MD_CTX_new();
-    if (ctx == NULL) {
-        EVP_PKEY_free(key);
-        return LCB_EINVAL;
-    }
-    rc = EVP_DigestSignInit(ctx, NULL, md, NULL, key);
-    if (rc != 1) {
-        EVP_PKEY_free(key);
-        return LCB_EINVAL;
+    if (!contexts || EVP_MD_CTX_copy_ex(contexts->md, contexts->hmac) != 1) {
+        return 0;
     }
-
     for (ii = 0; ii < inputs_num; ii++) {
-        rc = EVP_DigestSignUpdate(ctx, inputs[ii].data, inputs[ii].len);
-        if (rc != 1) {
-            EVP_PKEY_free(key);
-            EVP_MD_CTX_destroy(ctx);
-            return LCB_EINVAL;
+        if (EVP_DigestSignUpdate(contexts->md, inputs[ii].data, inputs[ii].len) != 1) {
+            return 0;
         }
     }
-    rc = EVP_DigestSignFinal(ctx, out, &out_len);
-    if (rc != 1 || out_len == 0) {
-        EVP_PKEY_free(key);
-        EVP_MD_CTX_destroy(ctx);
+    return EVP_DigestSignFinal(contexts->md, out, out_len) == 1 && *out_len > 0;
+}
+
+static lcb_error_t
+osp_sign(struct lcbcrypto_PROVIDER *provider, const lcbcrypto_SIGV *inputs, size_t inputs_num,
+        uint8_t **sig, size_t *sig_len)
+{
+    uint8_t out[EVP_MAX_MD_SIZE];
+    size_t out_len = EVP_MAX_MD_SIZE;
+
+    if (!osp_hmac(provider, inputs, inputs_num, out, &out_len)) {
         return LCB_EINVAL;
     }
     *sig = malloc(out_len);
@@ -118,50 +164,14 @@ static lcb_error_t
 osp_verify_signature(struct lcbcrypto_PROVIDER *provider, const lcbcrypto_SIGV *inputs,
         size_t inputs_num, uint8_t *sig, size_t sig_len)
 {
-    const EVP_MD *md;
     uint8_t actual[EVP_MAX_MD_SIZE];
     size_t actual_len = EVP_MAX_MD_SIZE;
-    int rc, key_len = strlen((const char *) common_hmac_sha256_key);
-    EVP_MD_CTX *ctx = NULL;
-    EVP_PKEY *key = NULL;
-    size_t ii;
 
-    md = EVP_get_digestbyname("SHA256");
-    if (md == NULL) {
+    if (!osp_hmac(provider, inputs, inputs_num, actual, &actual_len)) {
         return LCB_EINVAL;
     }
-    key = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, NULL, common_hmac_sha256_key, key_len);
-    if (key == NULL) {
-        return LCB_EINVAL;
-    }
-
-    ctx = EVP_MD_CTX_new();
-    if (ctx == NULL) {
-        EVP_PKEY_free(key);
-        return LCB_EINVAL;
-    }
-    rc = EVP_DigestSignInit(ctx, NULL, md, NULL, key);
-    if (rc != 1) {
-        EVP_PKEY_free(key);
-        return LCB_EINVAL;
-    }
-
-    for (ii = 0; ii < inputs_num; ii++) {
-        rc = EVP_DigestSignUpdate(ctx, inputs[ii].data, inputs[ii].len);
-        if (rc != 1) {
-            EVP_PKEY_free(key);
-            EVP_MD_CTX_destroy(ctx);
-            return LCB_EINVAL;
-        }
-    }
-    rc = EVP_DigestSignFinal(ctx, actual, &actual_len);
-    if (rc != 1 || actual_len == 0) {
-        EVP_PKEY_free(key);
-        EVP_MD_CTX_destroy(ctx);
-        return LCB_EINVAL;
-    }
-
-    if (memcmp(actual, sig, sig_len < actual_len ? sig_len : actual_len) == 0) {
+    /* a truncated signature is no signature */
+    if (sig_len == actual_len && CRYPTO_memcmp(actual, sig, sig_len) == 0) {
         return LCB_SUCCESS;
     }
     return LCB_EINVAL;
@@ -171,42 +181,38 @@ static lcb_error_t
 osp_encrypt(struct lcbcrypto_PROVIDER *provider, const uint8_t *input, size_t input_len,
         const uint8_t *iv, size_t iv_len, uint8_t **output, size_t *output_len)
 {
+    osp_contexts *contexts;
     EVP_CIPHER_CTX *ctx;
-    const EVP_CIPHER *cipher;
-    int rc, len, block_len, out_len;
+    int rc, len, out_len;
     uint8_t *out;
 
     if (iv_len != 16) {
         return LCB_EINVAL;
     }
 
-    ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
+    contexts = osp_get_contexts(provider);
+    if (!contexts) {
         return LCB_EINVAL;
     }
-    cipher = EVP_aes_256_cbc();
-    rc = EVP_EncryptInit_ex(ctx, cipher, NULL, common_aes256_key, iv);
+    /* the context keeps its key, and only takes the new IV */
+    ctx = contexts->encrypt;
+    rc = EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, 1);
     if (rc != 1) {
-        EVP_CIPHER_CTX_free(ctx);
         return LCB_EINVAL;
     }
-    block_len = EVP_CIPHER_block_size(cipher);
-    out = calloc(input_len + block_len - 1, sizeof(uint8_t));
+    out = calloc(input_len + EVP_CIPHER_CTX_block_size(ctx), sizeof(uint8_t));
     rc = EVP_EncryptUpdate(ctx, out, &len, input, input_len);
     if (rc != 1) {
         free(out);
-        EVP_CIPHER_CTX_free(ctx);
         return LCB_EINVAL;
     }
     out_len = len;
     rc = EVP_EncryptFinal_ex(ctx, out + len, &len);
     if (rc != 1) {
         free(out);
-        EVP_CIPHER_CTX_free(ctx);
         return LCB_EINVAL;
     }
     out_len += len;
-    EVP_CIPHER_CTX_free(ctx);
     *output = out;
     *output_len = out_len;
     return LCB_SUCCESS;
@@ -216,8 +222,8 @@ static lcb_error_t
 osp_decrypt(struct lcbcrypto_PROVIDER *provider, const uint8_t *input, size_t input_len,
         const uint8_t *iv, size_t iv_len, uint8_t **output, size_t *output_len)
 {
+    osp_contexts *contexts;
     EVP_CIPHER_CTX *ctx;
-    const EVP_CIPHER *cipher;
     int rc, len, out_len;
     uint8_t *out;
 
@@ -225,32 +231,28 @@ osp_decrypt(struct lcbcrypto_PROVIDER *provider, const uint8_t *input, size_t in
         return LCB_EINVAL;
     }
 
-    ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) {
+    contexts = osp_get_contexts(provider);
+    if (!contexts) {
         return LCB_EINVAL;
     }
-    cipher = EVP_aes_256_cbc();
-    rc = EVP_DecryptInit_ex(ctx, cipher, NULL, common_aes256_key, iv);
+    ctx = contexts->decrypt;
+    rc = EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, 0);
     if (rc != 1) {
-        EVP_CIPHER_CTX_free(ctx);
         return LCB_EINVAL;
     }
-    out = calloc(input_len, sizeof(uint8_t));
+    out = calloc(input_len + EVP_CIPHER_CTX_block_size(ctx), sizeof(uint8_t));
     rc = EVP_DecryptUpdate(ctx, out, &len, input, input_len);
     if (rc != 1) {
         free(out);
-        EVP_CIPHER_CTX_free(ctx);
         return LCB_EINVAL;
     }
     out_len = len;
     rc = EVP_DecryptFinal_ex(ctx, out + len, &len);
     if (rc != 1) {
         free(out);
-        EVP_CIPHER_CTX_free(ctx);
         return LCB_EINVAL;
     }
     out_len += len;
-    EVP_CIPHER_CTX_free(ctx);
     *output = out;
     *output_len = out_len;
     return LCB_SUCCESS;
@@ -260,7 +262,18 @@ lcbcrypto_PROVIDER *
 osp_create()
 {
     lcbcrypto_PROVIDER *provider = calloc(1, sizeof(lcbcrypto_PROVIDER));
+    osp_state *state = calloc(1, sizeof(osp_state));
+
+    state->md = EVP_sha256();
+    state->hmac_key = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, NULL, common_hmac_sha256_key,
+            strlen((const char *) common_hmac_sha256_key));
+    if (!state->hmac_key) {
+        fprintf(stderr, "Failed to create HMAC key: %s\n", ERR_error_string(ERR_get_error(), NULL));
+    }
+    pthread_key_create(&state->contexts, osp_free_contexts);
+
     provider->version = 1;
+    provider->cookie = state;
     provider->destructor = osp_free;
     provider->v.v1.release_bytes = osp_release_bytes;
     provider->v.v1.generate_iv = osp_generate_iv;
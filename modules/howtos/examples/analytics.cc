@@ -19,6 +19,7 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 #include <libcouchbase/couchbase.h>
 
@@ -37,6 +38,33 @@ static void check(lcb_STATUS err, const char *msg)
     }
 }
 
+struct analytics_error {
+    int code{0};
+    std::string msg{};
+    bool has_code{false};
+    bool has_msg{false};
+};
+
+static int collect_error(void *ctx, int path, int element, const cJSON *value)
+{
+    auto *errors = static_cast<std::vector<analytics_error> *>(ctx);
+    if (element < 0) {
+        return 1;
+    }
+    if (errors->size() <= static_cast<size_t>(element)) {
+        errors->resize(element + 1);
+    }
+    analytics_error &err = (*errors)[element];
+    if (path == 0 && value->type == cJSON_Number) {
+        err.code = value->valueint;
+        err.has_code = true;
+    } else if (path == 1 && value->type == cJSON_String) {
+        err.msg = value->valuestring;
+        err.has_msg = true;
+    }
+    return 1;
+}
+
 static void row_callback(lcb_INSTANCE *instance, int, const lcb_RESPANALYTICS *resp)
 {
     // tag::result[]
@@ -59,30 +87,16 @@ static void row_callback(lcb_INSTANCE *instance, int, const lcb_RESPANALYTICS *r
         }
         printf("\n");
         if (nrow) {
-            cJSON *json;
-            char *data = new char[nrow + 1];
-            memcpy(data, row, nrow); /* copy to ensure trailing zero */
-            json = cJSON_Parse(data);
-            if (json && json->type == cJSON_Object) {
-                cJSON *errors = cJSON_GetObjectItem(json, "errors");
-                if (errors && errors->type == cJSON_Array) {
-                    int ii, nerrors = cJSON_GetArraySize(errors);
-                    for (ii = 0; ii < nerrors; ii++) {
-                        cJSON *err = cJSON_GetArrayItem(errors, ii);
-                        if (err && err->type == cJSON_Object) {
-                            cJSON *code, *msg;
-                            code = cJSON_GetObjectItem(err, "code");
-                            msg = cJSON_GetObjectItem(err, "msg");
-                            if (code && code->type == cJSON_Number && msg && msg->type == cJSON_String) {
-                                printf(
-                                    "\x1b[1mcode\x1b[0m: \x1b[31m%d\x1b[0m, \x1b[1mmessage\x1b[0m: \x1b[31m%s\x1b[0m\n",
-                                    code->valueint, msg->valuestring);
-                            }
-                        }
-                    }
+            /* pick the error codes and messages straight from the row, it is not NUL-terminated */
+            static const char *paths[] = {"errors[].code", "errors[].msg"};
+            std::vector<analytics_error> errors;
+            cJSON_Filter(row, nrow, paths, 2, collect_error, &errors);
+            for (const analytics_error &err : errors) {
+                if (err.has_code && err.has_msg) {
+                    printf("\x1b[1mcode\x1b[0m: \x1b[31m%d\x1b[0m, \x1b[1mmessage\x1b[0m: \x1b[31m%s\x1b[0m\n",
+                           err.code, err.msg.c_str());
                 }
             }
-            delete[] data;
         }
     }
 
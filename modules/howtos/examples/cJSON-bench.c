@@ -0,0 +1,673 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * Micro-benchmarks for the bundled cJSON library. It does not need a cluster, just run the binary:
+ *
+ *     $ ./cJSON-bench [ iterations ]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cJSON.h"
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *name, int iterations, size_t bytes, double elapsed)
+{
+    printf("%-32s %12.3f us/op %10.1f MB/s\n", name, elapsed * 1e6 / iterations,
+           (double) bytes * iterations / elapsed / (1024 * 1024));
+}
+
+/* [0, "item-0", {"id": 0, "name": "item-0", "tags": ["a", "b"]}, 1, "item-1", ...] */
+static cJSON *
+make_large_array(int count)
+{
+    int i;
+    char name[32];
+    cJSON *array = cJSON_CreateArray();
+
+    for (i = 0; i < count; i++) {
+        cJSON *obj = cJSON_CreateObject();
+        const char *tags[] = {"a", "b"};
+
+        snprintf(name, sizeof(name), "item-%d", i);
+        cJSON_AddItemToArray(array, cJSON_CreateNumber(i));
+        cJSON_AddItemToArray(array, cJSON_CreateString(name));
+        cJSON_AddNumberToObject(obj, "id", i);
+        cJSON_AddStringToObject(obj, "name", name);
+        cJSON_AddItemToObject(obj, "tags", cJSON_CreateStringArray(tags, 2));
+        cJSON_AddItemToArray(array, obj);
+    }
+    return array;
+}
+
+/* {"level": 0, "label": "...", "next": {"level": 1, "label": "...", "next": {...}}} */
+static cJSON *
+make_deep_object(int depth)
+{
+    int i;
+    cJSON *root = cJSON_CreateObject(), *cur = root;
+
+    for (i = 0; i < depth; i++) {
+        cJSON *next = cJSON_CreateObject();
+        cJSON_AddNumberToObject(cur, "level", i);
+        cJSON_AddStringToObject(cur, "label", "The old grey goose jumped over the wrickety gate.");
+        cJSON_AddItemToObject(cur, "next", next);
+        cur = next;
+    }
+    return root;
+}
+
+/* {"name": "...", "avatar": "iVBORw0KGgo..."}, strings dominate like in the documents of the bincoding example */
+static cJSON *
+make_avatar(size_t size)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i;
+    char *avatar = malloc(size + 1);
+    cJSON *root = cJSON_CreateObject();
+
+    for (i = 0; i < size; i++) {
+        avatar[i] = alphabet[(i * 7 + i / 64) % 64];
+    }
+    avatar[size] = '\0';
+    cJSON_AddStringToObject(root, "name", "Griet");
+    cJSON_AddStringToObject(root, "avatar", avatar);
+    free(avatar);
+    return root;
+}
+
+/* [0.5, 1.6180339887, 2.71828, ...] */
+static cJSON *
+make_double_array(int count)
+{
+    int i;
+    cJSON *array;
+    double *numbers = malloc(count * sizeof(double));
+
+    for (i = 0; i < count; i++) {
+        numbers[i] = i * 1.6180339887 + 1.0 / (i + 2);
+    }
+    array = cJSON_CreateDoubleArray(numbers, count);
+    free(numbers);
+    return array;
+}
+
+/* [0, 3037000493, 6074000986, ...], the size of CAS values and counters */
+static cJSON *
+make_int64_array(int count)
+{
+    int i;
+    cJSON *array = cJSON_CreateArray();
+
+    for (i = 0; i < count; i++) {
+        cJSON_AddItemToArray(array, cJSON_CreateInt64(i * 3037000493LL * 1000));
+    }
+    return array;
+}
+
+static void
+bench_print(const char *name, cJSON *json, int iterations)
+{
+    int i;
+    double start;
+    char label[64];
+    char *out = cJSON_PrintUnformatted(json);
+    size_t len = strlen(out);
+    char *buf = malloc(len + 1);
+
+    free(out);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        free(cJSON_PrintUnformatted(json));
+    }
+    snprintf(label, sizeof(label), "%s/PrintUnformatted", name);
+    report(label, iterations, len, now() - start);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        free(cJSON_PrintBuffered(json, (int) len + 1, 0));
+    }
+    snprintf(label, sizeof(label), "%s/PrintBuffered", name);
+    report(label, iterations, len, now() - start);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        if (!cJSON_PrintPreallocated(json, buf, (int) len + 1, 0)) {
+            fprintf(stderr, "%s: the output does not fit into preallocated buffer\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+    snprintf(label, sizeof(label), "%s/PrintPreallocated", name);
+    report(label, iterations, len, now() - start);
+
+    free(buf);
+}
+
+static void
+bench_parse(const char *name, const char *text, int iterations)
+{
+    int i;
+    double start;
+    char label[64];
+    size_t len = strlen(text);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        cJSON *json = cJSON_Parse(text);
+        if (!json) {
+            fprintf(stderr, "%s: failed to parse\n", name);
+            exit(EXIT_FAILURE);
+        }
+        cJSON_Delete(json);
+    }
+    snprintf(label, sizeof(label), "%s/Parse+Delete", name);
+    report(label, iterations, len, now() - start);
+}
+
+/* Walk the array by position, like code written against cJSON_GetArraySize() and cJSON_GetArrayItem() does */
+static void
+bench_index(const char *name, cJSON *json, int iterations)
+{
+    int i, j, size = 0;
+    double start;
+    char label[64];
+    long sum = 0;
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        size = cJSON_GetArraySize(json);
+        for (j = 0; j < size; j++) {
+            sum += cJSON_GetArrayItem(json, j)->type;
+        }
+    }
+    if (!sum) {
+        fprintf(stderr, "%s: no items\n", name);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(label, sizeof(label), "%s/GetArrayItem", name);
+    report(label, iterations * size, sizeof(cJSON), now() - start);
+}
+
+/* Walk a reference to the array by position while the original shrinks. The reference shares the children of the
+   original, so it is never indexed, and has to see every change without stale positions */
+static void
+bench_reference(const char *name, int count)
+{
+    cJSON *array = make_large_array(count), *holder = cJSON_CreateArray(), *ref;
+    double start;
+    char label[64];
+    int i, steps = 0;
+
+    cJSON_AddItemReferenceToArray(holder, array);
+    ref = cJSON_GetArrayItem(holder, 0);
+    start = now();
+    for (i = count - 1; i > 10; i -= 7) {
+        if (cJSON_GetArrayItem(ref, i - 1) != cJSON_GetArrayItem(array, i - 1) ||
+            cJSON_GetArraySize(ref) != cJSON_GetArraySize(array)) {
+            fprintf(stderr, "%s: the reference does not match the array\n", name);
+            exit(EXIT_FAILURE);
+        }
+        cJSON_DeleteItemFromArray(array, i - 1);
+        steps++;
+    }
+    snprintf(label, sizeof(label), "%s/Reference", name);
+    report(label, steps, sizeof(cJSON), now() - start);
+    cJSON_Delete(holder);
+    cJSON_Delete(array);
+}
+
+static int
+count_filtered(void *ctx, int path, int element, const cJSON *value)
+{
+    (void) path;
+    (void) element;
+    (void) value;
+    (*(int *) ctx)++;
+    return 1;
+}
+
+static void
+bench_sax(const char *name, const char *text, const char *path, int iterations)
+{
+    int i, found = 0;
+    double start;
+    char label[64];
+    size_t len = strlen(text);
+    cJSON_SAXHandler handler;
+
+    memset(&handler, 0, sizeof(handler));
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        if (!cJSON_ParseSAX(text, len, &handler, 0)) {
+            fprintf(stderr, "%s: failed to parse\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+    snprintf(label, sizeof(label), "%s/ParseSAX", name);
+    report(label, iterations, len, now() - start);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        cJSON_Filter(text, len, &path, 1, count_filtered, &found);
+    }
+    if (!found) {
+        fprintf(stderr, "%s: \"%s\" not found\n", name, path);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(label, sizeof(label), "%s/Filter", name);
+    report(label, iterations, len, now() - start);
+}
+
+/* Every allocation carries its size in front of it, to know how much memory a document holds. */
+static size_t live_bytes;
+
+static void *
+counting_malloc(size_t size)
+{
+    size_t *block = malloc(size + 16);
+    if (!block) {
+        return 0;
+    }
+    *block = size;
+    live_bytes += size;
+    return (char *) block + 16;
+}
+
+static void
+counting_free(void *ptr)
+{
+    if (ptr) {
+        size_t *block = (size_t *) ((char *) ptr - 16);
+        live_bytes -= *block;
+        free(block);
+    }
+}
+
+static long
+tree_sum_ids(const cJSON *json)
+{
+    long sum = 0;
+    cJSON *item;
+
+    for (item = json->child; item; item = item->next) {
+        const cJSON *id = cJSON_GetObjectItemCaseSensitive(item, "id");
+        if (id) {
+            sum += id->valueint;
+        }
+    }
+    return sum;
+}
+
+static long
+tape_sum_ids(const cJSON_Tape *tape)
+{
+    long sum = 0;
+    size_t item;
+
+    for (item = cJSON_TapeChild(tape, 0); item != CJSON_TAPE_NONE; item = cJSON_TapeNext(tape, item)) {
+        size_t id = cJSON_TapeGetObjectItemCaseSensitive(tape, item, "id");
+        if (id != CJSON_TAPE_NONE) {
+            sum += (long) cJSON_TapeGetInt64(tape, id);
+        }
+    }
+    return sum;
+}
+
+/* Parse the document, sum the "id" members of the objects in the root array, and free it again, once with the
+   tree and once with the tape. */
+static void
+bench_tape(const char *name, const char *text, int iterations)
+{
+    int i;
+    double start;
+    char label[64];
+    size_t len = strlen(text), tree_bytes, tape_bytes;
+    long tree_sum = 0, tape_sum = 0;
+    cJSON_Hooks hooks = {counting_malloc, counting_free};
+    cJSON *json;
+    cJSON_Tape *tape;
+
+    cJSON_InitHooks(&hooks);
+    json = cJSON_Parse(text);
+    tree_bytes = live_bytes;
+    cJSON_Delete(json);
+    tape = cJSON_ParseTape(text, len);
+    tape_bytes = live_bytes;
+    cJSON_DeleteTape(tape);
+    cJSON_InitHooks(0);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        json = cJSON_Parse(text);
+        tree_sum += tree_sum_ids(json);
+        cJSON_Delete(json);
+    }
+    snprintf(label, sizeof(label), "%s/Tree", name);
+    report(label, iterations, len, now() - start);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        tape = cJSON_ParseTape(text, len);
+        if (!tape) {
+            fprintf(stderr, "%s: failed to parse\n", name);
+            exit(EXIT_FAILURE);
+        }
+        tape_sum += tape_sum_ids(tape);
+        cJSON_DeleteTape(tape);
+    }
+    snprintf(label, sizeof(label), "%s/Tape", name);
+    report(label, iterations, len, now() - start);
+
+    if (tree_sum != tape_sum) {
+        fprintf(stderr, "%s: the tape sums the ids to %ld, the tree to %ld\n", name, tape_sum, tree_sum);
+        exit(EXIT_FAILURE);
+    }
+    printf("%-32s %12zu bytes tree %10zu bytes tape\n", name, tree_bytes, tape_bytes);
+}
+
+typedef struct {
+    int changes;
+    size_t bytes;
+} diff_size;
+
+/* What sending the changes as sub-document mutations takes: the paths and the values. */
+static int
+measure_change(void *ctx, int op, const char *path, const cJSON *value)
+{
+    diff_size *size = ctx;
+
+    size->changes++;
+    size->bytes += strlen(path);
+    if (op != CJSON_DIFF_REMOVE) {
+        char *out = cJSON_PrintUnformatted((cJSON *) value);
+        size->bytes += strlen(out);
+        free(out);
+    }
+    return 1;
+}
+
+/* Compare a document with a copy of it with one member renamed and one item appended, like a read-modify-write
+   update does. */
+static void
+bench_diff(const char *name, cJSON *json, int iterations)
+{
+    int i;
+    double start;
+    char label[64];
+    char *text = cJSON_PrintUnformatted(json);
+    cJSON *changed = cJSON_Parse(text);
+    diff_size size = {0, 0};
+
+    cJSON_ReplaceItemInObject(cJSON_GetArrayItem(changed, 2), "name", cJSON_CreateString("renamed"));
+    cJSON_AddItemToArray(changed, cJSON_CreateString("appended"));
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        size.changes = 0;
+        size.bytes = 0;
+        if (!cJSON_Diff(json, changed, measure_change, &size)) {
+            fprintf(stderr, "%s: failed to diff\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+    snprintf(label, sizeof(label), "%s/Diff", name);
+    report(label, iterations, strlen(text), now() - start);
+    printf("%-32s %12d changes %10zu bytes instead of %zu\n", name, size.changes, size.bytes, strlen(text));
+
+    cJSON_Delete(changed);
+    free(text);
+}
+
+static int
+discard(void *ctx, const char *data, size_t len)
+{
+    (void) ctx;
+    (void) data;
+    (void) len;
+    return 1;
+}
+
+/* Read the lines of an NDJSON export one by one with cJSON_Parse and with the NDJSON reader, then write them back
+   with cJSON_PrintUnformatted and with the NDJSON writer. */
+static void
+bench_ndjson(const char *name, const char *row, int lines, int iterations)
+{
+    int i, j;
+    double start;
+    char label[64];
+    size_t row_len = strlen(row), len = (row_len + 1) * lines;
+    char *text = malloc(len), *line;
+    cJSON *json;
+    cJSON_NDJSONReader *reader;
+    cJSON_NDJSONWriter *writer;
+
+    for (j = 0; j < lines; j++) {
+        memcpy(text + j * (row_len + 1), row, row_len);
+        text[j * (row_len + 1) + row_len] = '\n';
+    }
+    json = cJSON_Parse(row);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        for (line = text; line < text + len; line += row_len + 1) {
+            cJSON_Delete(cJSON_ParseWithLength(line, row_len));
+        }
+    }
+    snprintf(label, sizeof(label), "%s/ParseLines", name);
+    report(label, iterations * lines, row_len + 1, now() - start);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        reader = cJSON_NDJSONReaderFromMemory(text, len);
+        for (j = 0; cJSON_NDJSONRead(reader); j++) {
+        }
+        if (j != lines || cJSON_NDJSONReaderFailed(reader)) {
+            fprintf(stderr, "%s: read %d of %d lines\n", name, j, lines);
+            exit(EXIT_FAILURE);
+        }
+        cJSON_NDJSONReaderFree(reader);
+    }
+    snprintf(label, sizeof(label), "%s/NDJSONRead", name);
+    report(label, iterations * lines, row_len + 1, now() - start);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        for (j = 0; j < lines; j++) {
+            char *out = cJSON_PrintUnformatted(json);
+            discard(0, out, strlen(out));
+            free(out);
+        }
+    }
+    snprintf(label, sizeof(label), "%s/PrintLines", name);
+    report(label, iterations * lines, row_len + 1, now() - start);
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        writer = cJSON_NDJSONWriterNew(discard, 0, 0);
+        for (j = 0; j < lines; j++) {
+            cJSON_NDJSONWrite(writer, json);
+        }
+        cJSON_NDJSONWriterFree(writer);
+    }
+    snprintf(label, sizeof(label), "%s/NDJSONWrite", name);
+    report(label, iterations * lines, row_len + 1, now() - start);
+
+    cJSON_Delete(json);
+    free(text);
+}
+
+/* a row of "SELECT * FROM `travel-sample` WHERE type = 'airline'" query */
+static const char *query_row = "{\"travel-sample\":{\"callsign\":\"MILE-AIR\",\"country\":\"United States\","
+                               "\"iata\":\"Q5\",\"icao\":\"MLA\",\"id\":10,\"name\":\"40-Mile Air\","
+                               "\"type\":\"airline\",\"schedule\":[{\"day\":0,\"utc\":\"10:13:00\","
+                               "\"flight\":\"AF198\"},{\"day\":1,\"utc\":\"19:18:00\",\"flight\":\"AF547\"}]}}";
+
+/* Pick the same six values out of a row again and again, with cJSON_GetObjectItem() chains, with compiled paths,
+   and with the paths compiled into one set. */
+static void
+bench_paths(const char *name, const char *row, int iterations)
+{
+    static const char *paths[] = {"travel-sample.callsign", "travel-sample.country", "travel-sample.id",
+                                  "travel-sample.name", "travel-sample.schedule[1].flight",
+                                  "travel-sample.schedule[0].utc"};
+    int i, j, npaths = sizeof(paths) / sizeof(paths[0]);
+    double start;
+    char label[64];
+    long hand = 0, compiled = 0;
+    cJSON *json = cJSON_Parse(row);
+    cJSON_Path *compiled_paths[sizeof(paths) / sizeof(paths[0])];
+
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        cJSON *doc = cJSON_GetObjectItem(json, "travel-sample");
+        cJSON *schedule = cJSON_GetObjectItem(doc, "schedule");
+        hand += (long) cJSON_GetObjectItem(doc, "callsign")->type;
+        hand += (long) cJSON_GetObjectItem(doc, "country")->type;
+        hand += (long) cJSON_GetObjectItem(doc, "id")->type;
+        hand += (long) cJSON_GetObjectItem(doc, "name")->type;
+        hand += (long) cJSON_GetObjectItem(cJSON_GetArrayItem(schedule, 1), "flight")->type;
+        hand += (long) cJSON_GetObjectItem(cJSON_GetArrayItem(schedule, 0), "utc")->type;
+    }
+    snprintf(label, sizeof(label), "%s/GetObjectItem", name);
+    report(label, iterations, strlen(row), now() - start);
+
+    for (j = 0; j < npaths; j++) {
+        compiled_paths[j] = cJSON_CompilePath(paths[j]);
+    }
+    start = now();
+    for (i = 0; i < iterations; i++) {
+        for (j = 0; j < npaths; j++) {
+            compiled += (long) cJSON_PathGet(compiled_paths[j], json)->type;
+        }
+    }
+    snprintf(label, sizeof(label), "%s/PathGet", name);
+    report(label, iterations, strlen(row), now() - start);
+
+    {
+        cJSON_PathSet *set = cJSON_CompilePathSet(paths, npaths);
+        cJSON *values[sizeof(paths) / sizeof(paths[0])];
+        long together = 0;
+
+        start = now();
+        for (i = 0; i < iterations; i++) {
+            cJSON_PathSetGet(set, json, values);
+            for (j = 0; j < npaths; j++) {
+                together += (long) values[j]->type;
+            }
+        }
+        snprintf(label, sizeof(label), "%s/PathSetGet", name);
+        report(label, iterations, strlen(row), now() - start);
+        cJSON_DeletePathSet(set);
+        if (together != hand) {
+            fprintf(stderr, "%s: the path set found other values than the chains\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (hand != compiled) {
+        fprintf(stderr, "%s: the paths found other values than the chains\n", name);
+        exit(EXIT_FAILURE);
+    }
+    for (j = 0; j < npaths; j++) {
+        cJSON_DeletePath(compiled_paths[j]);
+    }
+    cJSON_Delete(json);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int iterations = 20;
+    cJSON *json;
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+    }
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [ iterations ]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    json = make_large_array(100000);
+    bench_print("large-array", json, iterations);
+    bench_index("large-array", json, iterations);
+    bench_reference("large-array", 2000);
+    bench_diff("large-array", json, iterations);
+    {
+        char *text = cJSON_PrintUnformatted(json);
+        bench_parse("large-array", text, iterations);
+        bench_sax("large-array", text, "[].name", iterations);
+        bench_tape("large-array", text, iterations);
+        free(text);
+    }
+    cJSON_Delete(json);
+
+    bench_parse("query-row", query_row, iterations * 10000);
+    cJSON_SetPoolCacheLimit(1024 * 1024);
+    bench_parse("query-row-pool-cache", query_row, iterations * 10000);
+    cJSON_FreePoolCache();
+    bench_sax("query-row", query_row, "travel-sample.schedule[].flight", iterations * 10000);
+    bench_tape("query-row", query_row, iterations * 10000);
+    bench_ndjson("query-rows", query_row, 10000, iterations);
+    bench_paths("query-row", query_row, iterations * 100000);
+
+    json = make_double_array(100000);
+    bench_print("double-array", json, iterations);
+    {
+        char *text = cJSON_PrintUnformatted(json);
+        bench_parse("double-array", text, iterations);
+        free(text);
+    }
+    cJSON_Delete(json);
+
+    json = make_int64_array(100000);
+    bench_print("int64-array", json, iterations);
+    {
+        char *text = cJSON_PrintUnformatted(json);
+        bench_parse("int64-array", text, iterations);
+        free(text);
+    }
+    cJSON_Delete(json);
+
+    json = make_avatar(64 * 1024);
+    bench_print("avatar", json, iterations * 100);
+    {
+        char *text = cJSON_PrintUnformatted(json);
+        bench_parse("avatar", text, iterations * 100);
+        free(text);
+    }
+    cJSON_Delete(json);
+
+    json = make_deep_object(500);
+    bench_print("deep-object", json, iterations * 100);
+    cJSON_Delete(json);
+
+    return 0;
+}
@@ -0,0 +1,451 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * Benchmark suite for the bundled cJSON library over generated documents shaped like the traffic of the SDK: query
+ * rows, analytics error payloads, the Profile documents of the bincoding example, and ping reports. It does not need
+ * a cluster:
+ *
+ *     $ ./cJSON-corpus-bench [ documents [ rounds ] ]
+ *
+ * Every corpus is parsed, looked up, printed and deleted, each step timed over all documents and the best of the
+ * rounds reported. The results are printed as one JSON object per line, for example
+ *
+ *     {"corpus":"query-rows","op":"parse","docs":20000,"bytes":5342190,"seconds":0.021,"mb_per_s":242.6,
+ *      "docs_per_s":952380,"allocs_per_doc":1.00,"alloc_bytes_per_doc":1736.3}
+ *
+ * followed by a line with op "memory" for the peak of the heap of the corpus and the peak RSS. Every corpus is
+ * generated and run in a process of its own, so that the peak RSS is that of the corpus, and not of the largest one
+ * run before it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "cJSON.h"
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The hooks count the allocations, and keep the size in front of each block to follow the size of the heap. */
+static size_t allocs, alloc_bytes, live_bytes, peak_bytes;
+
+static void *
+counting_malloc(size_t size)
+{
+    size_t *block = malloc(size + 16);
+    if (!block) {
+        return 0;
+    }
+    *block = size;
+    allocs++;
+    alloc_bytes += size;
+    live_bytes += size;
+    if (live_bytes > peak_bytes) {
+        peak_bytes = live_bytes;
+    }
+    return (char *) block + 16;
+}
+
+static void
+counting_free(void *ptr)
+{
+    if (ptr) {
+        size_t *block = (size_t *) ((char *) ptr - 16);
+        live_bytes -= *block;
+        free(block);
+    }
+}
+
+static long
+peak_rss_kb(void)
+{
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss;
+    }
+#endif
+    return -1;
+}
+
+/* Deterministic generator, so that the corpora are the same on every run. */
+static unsigned int seed = 2020;
+
+static unsigned int
+next_random(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) & 0xFFFFFF;
+}
+
+static const char *
+pick(const char **words, int count)
+{
+    return words[next_random() % count];
+}
+
+typedef struct {
+    char **docs;
+    size_t *lens;
+    int count;
+    size_t bytes;
+} corpus;
+
+static void
+corpus_add(corpus *c, const char *text, size_t len)
+{
+    c->docs[c->count] = malloc(len + 1);
+    memcpy(c->docs[c->count], text, len + 1);
+    c->lens[c->count++] = len;
+    c->bytes += len;
+}
+
+static void
+corpus_init(corpus *c, int count)
+{
+    c->docs = malloc(count * sizeof(char *));
+    c->lens = malloc(count * sizeof(size_t));
+    c->count = 0;
+    c->bytes = 0;
+}
+
+static void
+corpus_free(corpus *c)
+{
+    int i;
+    for (i = 0; i < c->count; i++) {
+        free(c->docs[i]);
+    }
+    free(c->docs);
+    free(c->lens);
+}
+
+static const char *countries[] = {"United States", "France", "United Kingdom", "Germany", "Japan"};
+static const char *cities[] = {"San Francisco", "Paris", "London", "Berlin", "Tokyo", "Mountain View"};
+static const char *words[] = {"quiet", "cozy", "central", "historic", "modern", "bright", "spacious", "friendly"};
+
+/* Rows of "SELECT * FROM `travel-sample`" queries: airlines with schedules, and hotels with reviews. */
+static void
+make_query_rows(corpus *c, int count)
+{
+    char buf[4096];
+    int i, j, n;
+
+    corpus_init(c, count);
+    for (i = 0; i < count; i++) {
+        if (i % 2) {
+            n = snprintf(buf, sizeof(buf),
+                         "{\"travel-sample\":{\"callsign\":\"AIR-%d\",\"country\":\"%s\",\"iata\":\"Q%d\","
+                         "\"icao\":\"M%03d\",\"id\":%d,\"name\":\"%d-Mile Air\",\"type\":\"airline\",\"schedule\":[",
+                         i, pick(countries, 5), i % 10, i % 1000, i, i % 100);
+            for (j = 0; j < 1 + (int) (next_random() % 6); j++) {
+                n += snprintf(buf + n, sizeof(buf) - n,
+                              "%s{\"day\":%d,\"utc\":\"%02d:%02d:00\",\"flight\":\"AF%03d\"}", j ? "," : "",
+                              (int) (next_random() % 7), (int) (next_random() % 24), (int) (next_random() % 60),
+                              (int) (next_random() % 1000));
+            }
+            n += snprintf(buf + n, sizeof(buf) - n, "]}}");
+        } else {
+            n = snprintf(buf, sizeof(buf),
+                         "{\"travel-sample\":{\"address\":\"%d %s Street\",\"city\":\"%s\",\"country\":\"%s\","
+                         "\"free_breakfast\":%s,\"geo\":{\"accuracy\":\"ROOFTOP\",\"lat\":%.6f,\"lon\":%.6f},"
+                         "\"id\":%d,\"name\":\"The %s Inn\",\"price\":%d.%02d,\"type\":\"hotel\",\"reviews\":[",
+                         i % 500, pick(words, 8), pick(cities, 6), pick(countries, 5),
+                         next_random() % 2 ? "true" : "false", (next_random() % 180000) / 1000.0 - 90,
+                         (next_random() % 360000) / 1000.0 - 180, i, pick(words, 8), (int) (next_random() % 400),
+                         (int) (next_random() % 100));
+            for (j = 0; j < (int) (next_random() % 4); j++) {
+                n += snprintf(buf + n, sizeof(buf) - n,
+                              "%s{\"author\":\"Guest %d\",\"content\":\"A %s and %s place, we would come back.\","
+                              "\"ratings\":{\"Overall\":%d,\"Service\":%d}}",
+                              j ? "," : "", (int) (next_random() % 10000), pick(words, 8), pick(words, 8),
+                              (int) (next_random() % 5 + 1), (int) (next_random() % 5 + 1));
+            }
+            n += snprintf(buf + n, sizeof(buf) - n, "]}}");
+        }
+        corpus_add(c, buf, n);
+    }
+}
+
+/* The final payloads of failed analytics queries, with their errors and metrics. */
+static void
+make_analytics_errors(corpus *c, int count)
+{
+    static const char *messages[] = {"Cannot find dataset with name breweries in dataverse Default",
+                                     "Syntax error: In line 1 >>SELECT * FORM breweries;<< Encountered \\\"FORM\\\"",
+                                     "Request timed out and will be cancelled",
+                                     "Cannot resolve ambiguous alias reference for identifier name"};
+    static const int codes[] = {24045, 24000, 21002, 24025};
+    char buf[4096];
+    int i, j, n, kind;
+
+    corpus_init(c, count);
+    for (i = 0; i < count; i++) {
+        n = snprintf(buf, sizeof(buf),
+                     "{\"requestID\":\"%08x-%04x-%04x-%04x-%06x%06x\",\"signature\":{\"*\":\"*\"},\"errors\":[",
+                     next_random(), next_random() & 0xFFFF, next_random() & 0xFFFF, next_random() & 0xFFFF,
+                     next_random(), next_random());
+        for (j = 0; j < 1 + (int) (next_random() % 3); j++) {
+            kind = next_random() % 4;
+            n += snprintf(buf + n, sizeof(buf) - n, "%s{\"code\":%d,\"msg\":\"%s\"}", j ? "," : "", codes[kind],
+                          messages[kind]);
+        }
+        n += snprintf(buf + n, sizeof(buf) - n,
+                      "],\"status\":\"fatal\",\"metrics\":{\"elapsedTime\":\"%d.%06dms\",\"executionTime\":"
+                      "\"%d.%06dms\",\"resultCount\":0,\"resultSize\":0,\"processedObjects\":0,\"errorCount\":%d}}",
+                      (int) (next_random() % 100), (int) (next_random() % 1000000), (int) (next_random() % 100),
+                      (int) (next_random() % 1000000), j);
+        corpus_add(c, buf, n);
+    }
+}
+
+/* The documents of the bincoding example: a name, an age, and a base64 encoded avatar of 1 to 48 KiB. */
+static void
+make_profiles(corpus *c, int count)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static const char *names[] = {"Griet", "Vermeer", "Catharina", "Pieter", "Tanneke", "Maria"};
+    size_t size = 72 + 4 * (48 * 1024 / 3) + 4;
+    char *buf = malloc(size);
+    int i, n, k, len;
+
+    corpus_init(c, count);
+    for (i = 0; i < count; i++) {
+        len = 4 * ((1024 + next_random() % (47 * 1024)) / 3);
+        n = snprintf(buf, size, "{\"name\":\"%s\",\"age\":%d,\"avatar\":\"", pick(names, 6),
+                     (int) (16 + next_random() % 60));
+        for (k = 0; k < len; k++) {
+            buf[n++] = alphabet[next_random() % 64];
+        }
+        n += snprintf(buf + n, size - n, "\"}");
+        corpus_add(c, buf, n);
+    }
+    free(buf);
+}
+
+/* The reports of lcb_ping for a cluster of a few nodes. */
+static void
+make_ping_reports(corpus *c, int count)
+{
+    static const char *services[] = {"kv", "views", "n1ql", "fts", "cbas"};
+    static const int ports[] = {11210, 8092, 8093, 8094, 8095};
+    char buf[8192];
+    int i, s, node, nodes, n;
+
+    corpus_init(c, count);
+    for (i = 0; i < count; i++) {
+        nodes = 1 + next_random() % 4;
+        n = snprintf(buf, sizeof(buf),
+                     "{\"version\":1,\"id\":\"0x%x\",\"sdk\":\"libcouchbase/3.0.1\",\"config_rev\":%d,\"services\":{",
+                     next_random(), (int) (next_random() % 5000));
+        for (s = 0; s < 5; s++) {
+            n += snprintf(buf + n, sizeof(buf) - n, "%s\"%s\":[", s ? "," : "", services[s]);
+            for (node = 0; node < nodes; node++) {
+                n += snprintf(buf + n, sizeof(buf) - n,
+                              "%s{\"id\":\"0x%x\",\"latency_us\":%d,\"local\":\"10.0.0.1:%d\","
+                              "\"remote\":\"10.0.0.%d:%d\",\"state\":\"%s\"%s}",
+                              node ? "," : "", next_random(), (int) (50 + next_random() % 5000),
+                              (int) (40000 + next_random() % 20000), 10 + node, ports[s],
+                              next_random() % 20 ? "ok" : "timeout",
+                              s == 0 ? ",\"namespace\":\"travel-sample\"" : "");
+            }
+            n += snprintf(buf + n, sizeof(buf) - n, "]");
+        }
+        n += snprintf(buf + n, sizeof(buf) - n, "}}");
+        corpus_add(c, buf, n);
+    }
+}
+
+static void
+report(const char *name, const char *op, const corpus *c, size_t bytes, double seconds, size_t op_allocs,
+       size_t op_alloc_bytes)
+{
+    printf("{\"corpus\":\"%s\",\"op\":\"%s\",\"docs\":%d,\"bytes\":%zu,\"seconds\":%.6f,\"mb_per_s\":%.1f,"
+           "\"docs_per_s\":%.0f,\"allocs_per_doc\":%.2f,\"alloc_bytes_per_doc\":%.1f}\n",
+           name, op, c->count, bytes, seconds, bytes / seconds / (1024 * 1024), c->count / seconds,
+           (double) op_allocs / c->count, (double) op_alloc_bytes / c->count);
+}
+
+static void
+fail(const char *name, const char *what)
+{
+    fprintf(stderr, "%s: %s\n", name, what);
+    exit(EXIT_FAILURE);
+}
+
+/* Run the steps over all documents of the corpus, rounds times, and report the best round of each. */
+static void
+run(const char *name, const corpus *c, const char **paths, int npaths, int rounds)
+{
+    cJSON **trees = malloc(c->count * sizeof(cJSON *));
+    cJSON_Path **compiled = malloc(npaths * sizeof(cJSON_Path *));
+    double best[4] = {0, 0, 0, 0}, start, elapsed;
+    size_t ops_allocs[4], ops_alloc_bytes[4], printed = 0, looked_up = 0;
+    int round, i, j, op;
+
+    for (j = 0; j < npaths; j++) {
+        if (!(compiled[j] = cJSON_CompilePath(paths[j]))) {
+            fail(name, "malformed path");
+        }
+    }
+    peak_bytes = live_bytes;
+
+    for (round = 0; round < rounds; round++) {
+        for (op = 0; op < 4; op++) {
+            allocs = alloc_bytes = 0;
+            start = now();
+            switch (op) {
+                case 0:
+                    for (i = 0; i < c->count; i++) {
+                        if (!(trees[i] = cJSON_ParseWithLength(c->docs[i], c->lens[i]))) {
+                            fail(name, "failed to parse");
+                        }
+                    }
+                    break;
+                case 1:
+                    looked_up = 0;
+                    for (i = 0; i < c->count; i++) {
+                        for (j = 0; j < npaths; j++) {
+                            looked_up += cJSON_PathGet(compiled[j], trees[i]) != 0;
+                        }
+                    }
+                    break;
+                case 2:
+                    printed = 0;
+                    for (i = 0; i < c->count; i++) {
+                        char *out = cJSON_PrintUnformatted(trees[i]);
+                        if (!out) {
+                            fail(name, "failed to print");
+                        }
+                        printed += strlen(out);
+                        counting_free(out);
+                    }
+                    break;
+                case 3:
+                    for (i = 0; i < c->count; i++) {
+                        cJSON_Delete(trees[i]);
+                    }
+                    break;
+            }
+            elapsed = now() - start;
+            if (!round || elapsed < best[op]) {
+                best[op] = elapsed;
+            }
+            ops_allocs[op] = allocs;
+            ops_alloc_bytes[op] = alloc_bytes;
+        }
+    }
+    if (!looked_up) {
+        fail(name, "none of the paths found anything");
+    }
+
+    report(name, "parse", c, c->bytes, best[0], ops_allocs[0], ops_alloc_bytes[0]);
+    report(name, "lookup", c, c->bytes, best[1], ops_allocs[1], ops_alloc_bytes[1]);
+    report(name, "print", c, printed, best[2], ops_allocs[2], ops_alloc_bytes[2]);
+    report(name, "delete", c, c->bytes, best[3], ops_allocs[3], ops_alloc_bytes[3]);
+    printf("{\"corpus\":\"%s\",\"op\":\"memory\",\"docs\":%d,\"bytes\":%zu,\"heap_peak_bytes\":%zu,"
+           "\"peak_rss_kb\":%ld}\n",
+           name, c->count, c->bytes, peak_bytes, peak_rss_kb());
+    fflush(stdout);
+
+    for (j = 0; j < npaths; j++) {
+        cJSON_DeletePath(compiled[j]);
+    }
+    free(compiled);
+    free(trees);
+}
+
+typedef void (*corpus_maker)(corpus *c, int count);
+
+static void
+run_corpus(const char *name, corpus_maker make, int count, const char **paths, int npaths, int rounds)
+{
+    corpus c;
+#ifndef _WIN32
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid > 0) {
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            fprintf(stderr, "%s: the benchmark failed\n", name);
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+#endif
+    make(&c, count);
+    run(name, &c, paths, npaths, rounds);
+    corpus_free(&c);
+#ifndef _WIN32
+    exit(EXIT_SUCCESS);
+#endif
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const char *row_paths[] = {"travel-sample.id", "travel-sample.name", "travel-sample.country",
+                                      "travel-sample.schedule[0].flight", "travel-sample.geo.lat"};
+    static const char *error_paths[] = {"status", "errors[0].code", "errors[0].msg", "metrics.errorCount"};
+    static const char *profile_paths[] = {"name", "age", "avatar"};
+    static const char *ping_paths[] = {"config_rev", "services.kv[0].latency_us", "services.n1ql[-1].state"};
+    int docs = 20000, rounds = 5;
+    cJSON_Hooks hooks = {counting_malloc, counting_free};
+
+    if (argc > 1) {
+        docs = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        rounds = atoi(argv[2]);
+    }
+    if (docs <= 0 || rounds <= 0) {
+        fprintf(stderr, "Usage: %s [ documents [ rounds ] ]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    cJSON_InitHooks(&hooks);
+
+    run_corpus("query-rows", make_query_rows, docs, row_paths, sizeof(row_paths) / sizeof(row_paths[0]), rounds);
+    run_corpus("analytics-errors", make_analytics_errors, docs, error_paths,
+               sizeof(error_paths) / sizeof(error_paths[0]), rounds);
+    /* the profiles are large, fewer of them take about as long */
+    run_corpus("profiles", make_profiles, docs / 50 + 1, profile_paths,
+               sizeof(profile_paths) / sizeof(profile_paths[0]), rounds);
+    run_corpus("ping-reports", make_ping_reports, docs, ping_paths, sizeof(ping_paths) / sizeof(ping_paths[0]),
+               rounds);
+
+    cJSON_InitHooks(0);
+    return 0;
+}